@@ -0,0 +1,34 @@
+#include "../src/hash.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// the data is fed in uneven pieces, so that both the buffered and the striped path are checked against the reference XXH64
+static bool checkDigest(const char* name, const void* data, size_t len, size_t piece, uint64_t expect) {
+	HashState hs;
+	hashInit(&hs);
+	for (size_t pos = 0; pos < len; pos += piece)
+		hashUpdate(&hs, (const char*)data + pos, len - pos < piece ? len - pos : piece);
+	uint64_t got = hashDigest(&hs);
+	if (got != expect) {
+		printf("'hash %s' failed: expected %016llX got %016llX\n", name, (unsigned long long)expect, (unsigned long long)got);
+		return false;
+	}
+	printf("'hash %s' passed\n", name);
+	return true;
+}
+
+int main(void) {
+	static const char text[] = "Nobody inspects the spammish repetition";
+	unsigned char block[1027];
+	for (size_t i = 0; i < 1024; ++i)
+		block[i] = (unsigned char)i;
+	memcpy(block + 1024, "xyz", 3);
+
+	bool ok = checkDigest("empty", "", 0, 1, 0xEF46DB3751D8E999ULL);
+	ok = checkDigest("abc", "abc", 3, 3, 0x44BC2CF5AD770999ULL) && ok;
+	ok = checkDigest("sentence", text, sizeof(text) - 1, 5, 0xFBCEA83C8A378BF1ULL) && ok;
+	ok = checkDigest("block", block, sizeof(block), 7, 0xE146CB31B65BC21AULL) && ok;
+	ok = checkDigest("block whole", block, sizeof(block), sizeof(block), 0xE146CB31B65BC21AULL) && ok;
+	return ok ? 0 : 1;
+}
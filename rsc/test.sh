@@ -41,6 +41,40 @@ massTest() {
 	echo "'$ENAME $1' passed"
 }
 
+# creates files in the test directory along with their parent directories, where "name=text" also writes the text into the file
+makeFiles() {
+	for it in "$@"; do
+		mkdir -p "$(dirname "$DIR/${it%%=*}")"
+		if [[ $it == *=* ]]; then
+			echo "${it#*=}" > "$DIR/${it%%=*}"
+		else
+			touch "$DIR/$it"
+		fi
+	done
+}
+
+# checks the test directory after a test, where "!name" mustn't exist, "name=text" has to hold the text and "name~pattern" has to contain the pattern, and empties the directory once all of them hold
+checkFiles() {
+	local NAME=$1
+	shift
+	for it in "$@"; do
+		case $it in
+		!*) ! test -e "$DIR/${it:1}" ;;
+		*=*) test "$(cat "$DIR/${it%%=*}" 2>/dev/null)" = "${it#*=}" ;;
+		*~*) grep -q -- "${it#*~}" "$DIR/${it%%~*}" 2>/dev/null ;;
+		*) test -e "$DIR/$it" ;;
+		esac
+		if test $? -ne 0; then
+			echo "'$ENAME $NAME' failed: '$it'"
+			OK=false
+			return
+		fi
+	done
+	echo "'$ENAME $NAME' passed"
+	rm -r "$DIR"
+	mkdir "$DIR"
+}
+
 if test -d "$DIR"; then
 	rm -r "$DIR"
 fi
@@ -84,6 +118,198 @@ INAMES=("ai" "bi" "ci" "di" "ei")
 ONAMES=("dec01_ai" "dec04_bi" "dec07_ci" "dec10_di" "dec13_ei")
 massTest "-z -K 0 -L 1 -T 3 -B 10 -G 2 -C 0 -P dec -S _" INAMES ONAMES
 
+singleTest "-D hardlink -d $DIR -n blank" "file" "blank"
+singleTest "-D copy -V -d $DIR -n blank" "file" "blank"
+singleTest "-W --sync-every 1 -n blank" "file" "blank"
+singleTest "-W --syncfs -n blank" "file" "blank"
+singleTest "-D copy -w -d $DIR -n blank" "file" "blank"
+rm "$DIR/file"
+
+makeFiles file
+$EXE -J "$DIR/journal" -n blank "$DIR/file"
+$EXE -U "$DIR/journal"
+checkFiles "-U" file '!blank'
+
+makeFiles file
+(cd "$DIR" && $(realpath "$(command -v "$1")") -gaZ -J journal -n blank file)
+$EXE -U "$DIR/journal"
+checkFiles "-J relative path" file '!blank'
+
+makeFiles sub/other file
+$EXE -s _new "$DIR/sub/..//./file"
+checkFiles "normalized path" file_new sub/other '!file'
+
+makeFiles dir/file out/dir/other
+$EXE -J "$DIR/journal" -D copy -d "$DIR/out" "$DIR/dir"
+$EXE -U "$DIR/journal"
+checkFiles "-D copy -U" dir/file out/dir/other '!out/dir/file'
+
+makeFiles file0 file2
+$EXE --checkpoint "$DIR/checkpoint" -s _new "$DIR/file0" "$DIR/file1" "$DIR/file2"
+makeFiles file1
+$EXE --checkpoint "$DIR/checkpoint" --resume -s _new "$DIR/file0" "$DIR/file1" "$DIR/file2"
+checkFiles "--resume" file0_new file1_new file2_new '!checkpoint'
+
+makeFiles file
+$EXE --plan-out "$DIR/plan" -n blank "$DIR/file"
+$EXE --plan-in "$DIR/plan"
+checkFiles "--plan-in" blank '!file'
+
+makeFiles file0 file1
+$EXE --plan-out "$DIR/plan" -p new "$DIR/file0" "$DIR/file1"
+makeFiles newfile1=taken
+$EXE --plan-in "$DIR/plan" 2> /dev/null
+checkFiles "--plan-in existing destination" file0 file1 newfile1=taken '!newfile0'
+
+makeFiles file0=0 file1=1
+$EXE -n blank "$DIR/file0" "$DIR/file1" 2> /dev/null
+checkFiles "preflight same name" file0=0 file1=1 '!blank'
+
+makeFiles dir0/file0 dir1/file1
+$EXE --plan-out "$DIR/plan" -s _new "$DIR/dir0/file0" "$DIR/dir1/file1"
+$EXE --plan-in "$DIR/plan" --plan-shards 2 > /dev/null
+$EXE --plan-in "$DIR/plan.0"
+$EXE --plan-in "$DIR/plan.1"
+checkFiles "--plan-shards" dir0/file0_new dir1/file1_new '!dir0/file0' '!dir1/file1'
+
+makeFiles file0 file1
+$EXE -J "$DIR/journal0" -n blank0 "$DIR/file0"
+$EXE -J "$DIR/journal1" -n blank1 "$DIR/file1"
+$EXE --merge-journal "$DIR/journal" "$DIR/journal0" "$DIR/journal1"
+$EXE -U "$DIR/journal"
+checkFiles "--merge-journal" file0 file1 '!blank0' '!blank1'
+
+makeFiles file0 file1
+printf "%s\0" "$DIR/file0" "$DIR/file1" | $EXE --files-from - -0 -s _new
+checkFiles "--files-from" file0_new file1_new
+
+makeFiles file0 file2
+printf "%s\n" "$DIR/file0" "$DIR/file1" "$DIR/file2" > "$DIR/list"
+$EXE --files-from "$DIR/list" --checkpoint "$DIR/checkpoint" -s _new
+printf "%s\n" "$DIR/file2" "$DIR/file1" "$DIR/file0" > "$DIR/list"
+makeFiles file1
+$EXE --files-from "$DIR/list" --checkpoint "$DIR/checkpoint" --resume -s _new 2> /dev/null
+checkFiles "--files-from --resume changed list" file0_new file1 file2 checkpoint
+
+makeFiles file
+echo "$DIR/file" > "$DIR/list"
+$EXE --files-from "$DIR/list" -b -n blank 2> /dev/null
+checkFiles "--files-from --backwards" file '!blank'
+
+touch "$DIR"/file{0..1099}
+printf "$DIR/file%d\n" {0..1099} > "$DIR/list"
+$EXE --files-from "$DIR/list" --checkpoint "$DIR/missing/checkpoint" -s _new 2> /dev/null
+checkFiles "--checkpoint failed save" file1023_new file1024 file1099
+
+makeFiles sub/file0 sub/deep/file1
+$EXE --recursive --files-only -s _new "$DIR/sub"
+checkFiles "--recursive" sub/file0_new sub/deep/file1_new sub/deep
+
+makeFiles sub/file
+$EXE --recursive --checkpoint "$DIR/checkpoint" -p z_ "$DIR/sub"
+checkFiles "--recursive --checkpoint" sub/file '!z_sub' '!checkpoint'
+
+makeFiles file0.jpg file1.txt
+$EXE --include "*.jpg" -s _new "$DIR/file0.jpg" "$DIR/file1.txt"
+checkFiles "--include" file0_new.jpg file1.txt
+
+makeFiles file0.txt file1.jpg
+printf "[text]\nmatch=*.txt\noptions=-s _text\n" > "$DIR/rules"
+$EXE --rules "$DIR/rules" -s _other "$DIR/file0.txt" "$DIR/file1.jpg"
+checkFiles "--rules" file0_text.txt file1_other.jpg
+
+makeFiles file0 file2
+printf "[n]\nmatch=file*\noptions=-n x -L 1\n" > "$DIR/rules"
+$EXE --rules "$DIR/rules" --checkpoint "$DIR/checkpoint" "$DIR/file0" "$DIR/file1" "$DIR/file2"
+makeFiles file1
+$EXE --rules "$DIR/rules" --checkpoint "$DIR/checkpoint" --resume "$DIR/file0" "$DIR/file1" "$DIR/file2"
+checkFiles "--rules --resume" x1 x2 x3 '!checkpoint'
+
+makeFiles file
+printf "[j]\nmatch=*\noptions=-n x -J journal\n[k]\nmatch=*\noptions=-n x extra\n" > "$DIR/rules"
+$EXE --rules "$DIR/rules" "$DIR/file" 2> /dev/null
+checkFiles "--rules run options" file '!x' '!journal'
+
+makeFiles file
+$EXE -y --output json -n blank "$DIR/file" > "$DIR/output"
+checkFiles "--output" 'output~"dst":"blank"' file
+
+makeFiles file0.jpg file1.jpg file2.jpg
+$EXE --compute-threads 2 -s _new "$DIR/file0.jpg" "$DIR/file1.jpg" "$DIR/file2.jpg"
+checkFiles "--compute-threads" file0_new.jpg file1_new.jpg file2_new.jpg
+
+makeFiles dir0/file0.jpg dir1/file1.jpg
+$EXE --apply-threads 2 -s _new "$DIR/dir0/file0.jpg" "$DIR/dir1/file1.jpg"
+checkFiles "--apply-threads" dir0/file0_new.jpg dir1/file1_new.jpg
+
+makeFiles dir0/file0.jpg
+$EXE -y -v --apply-threads 2 --on-error "*=skip" -s _new "$DIR/dir0/file0.jpg" "$DIR/dir1/file1.jpg" > "$DIR/output"
+grep -q file1 "$DIR/output" && mv "$DIR/output" "$DIR/reported"
+checkFiles "--apply-threads -v" 'output~file0_new' '!reported'
+
+makeFiles a=a b=b
+printf "[a]\nmatch=a\noptions=-n b\n[b]\nmatch=b\noptions=-n a\n" > "$DIR/rules"
+$EXE --rules "$DIR/rules" --plan-out "$DIR/plan" "$DIR/a" "$DIR/b"
+$EXE --plan-in "$DIR/plan"
+checkFiles "--plan-out swap" a=b b=a
+
+makeFiles a=a b=b
+printf "[a]\nmatch=a\noptions=-n b\n[b]\nmatch=b\noptions=-n a\n" > "$DIR/rules"
+$EXE --rules "$DIR/rules" --plan-out "$DIR/plan" "$DIR/a" "$DIR/b"
+echo parked > "$DIR/.sfbrename-0"
+$EXE --plan-in "$DIR/plan"
+checkFiles "--plan-in taken parking name" a=b b=a .sfbrename-0=parked
+
+makeFiles a=a b=b
+printf "[a]\nmatch=a\noptions=-n b\n[b]\nmatch=b\noptions=-n a\n" > "$DIR/rules"
+$EXE --rules "$DIR/rules" "$DIR/a" "$DIR/b" 2> /dev/null
+checkFiles "swap without a plan" a=a b=b
+
+makeFiles dir0/file.jpg dir1/file.jpg out/.keep
+$EXE -D move -d "$DIR/out" --on-collision number "$DIR/dir0/file.jpg" "$DIR/dir1/file.jpg"
+checkFiles "--on-collision number" out/file.jpg out/file_2.jpg
+
+makeFiles dir0/file.jpg=0 dir1/file.jpg=1 out/file.jpg=out
+$EXE -D move -d "$DIR/out" --on-collision skip "$DIR/dir0/file.jpg" "$DIR/dir1/file.jpg"
+checkFiles "--on-collision skip" out/file.jpg=out dir0/file.jpg dir1/file.jpg
+
+makeFiles dir0/file.jpg dir1/file.jpg out/.keep
+$EXE -D move -d "$DIR/out" --on-collision suffix "$DIR/dir0/file.jpg" "$DIR/dir1/file.jpg"
+checkFiles "--on-collision suffix" "out/file.jpg" "out/file (2).jpg" '!out/file_2.jpg'
+
+makeFiles file0=0 file1=1 blank=other
+$EXE --on-collision number -n blank "$DIR/file0" "$DIR/file1"
+checkFiles "--on-collision in place" blank=other blank_2=0 blank_3=1
+
+makeFiles a=a b=b
+printf "[a]\nmatch=a\noptions=-n b\n[b]\nmatch=b\noptions=-n c\n" > "$DIR/rules"
+$EXE --rules "$DIR/rules" --on-collision number "$DIR/b" "$DIR/a"
+checkFiles "--on-collision chain" b=a c=b '!a' '!b_2'
+
+$EXE --on-error "ENOENT=collect" --error-report "$DIR/report" -n blank "$DIR/missing"
+checkFiles "--on-error" report~ENOENT '!blank'
+
+makeFiles file
+LONG=$(printf "%03000d" 0)
+$EXE --on-error "ENAMETOOLONG=collect" --error-report "$DIR/report" -p "$LONG" -s "$LONG" "$DIR/file"
+checkFiles "--on-error name" report~ENAMETOOLONG file
+
+makeFiles file
+$EXE --on-error "ENOENT=skp" -n blank "$DIR/file" 2> /dev/null && touch "$DIR/succeeded"
+checkFiles "--on-error invalid" file '!blank' '!succeeded'
+
+makeFiles file0.jpg file1.jpg file2.jpg
+START=$SECONDS
+$EXE --max-ops-per-sec 1 -s _new "$DIR/file0.jpg" "$DIR/file1.jpg" "$DIR/file2.jpg"
+echo $((SECONDS - START)) > "$DIR/seconds"
+checkFiles "--max-ops-per-sec" file0_new.jpg file1_new.jpg file2_new.jpg 'seconds~^[1-9]'
+
+head -c 65536 /dev/zero > "$DIR/file"
+START=$SECONDS
+$EXE --max-bytes-per-sec 32768 -D copy -d "$DIR" -n blank "$DIR/file"
+echo $((SECONDS - START)) > "$DIR/seconds"
+checkFiles "--max-bytes-per-sec" file blank 'seconds~^[1-9]'
+
 if $OK; then
 	rm -r $DIR
 else
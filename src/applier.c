@@ -0,0 +1,187 @@
+#include "applier.h"
+#include <stdatomic.h>
+
+#define APPLIER_QUEUE_MAX 4096
+
+typedef struct ApplyShard {
+	Applier* ap;
+	GThread* thread;
+	GAsyncQueue* queue;
+	size_t id;
+} ApplyShard;
+
+struct Applier {
+	ApplyShard* shards;
+	GHashTable* dirs;
+	GHashTable* owners;
+	ApplyFunc func;
+	void* data;
+	const char* lastSrc;
+	const char* lastDst;
+	size_t lastSrcLen;
+	size_t lastDstLen;
+	size_t lastShard;
+	size_t nShards;
+	size_t pending;
+	GMutex mutex;
+	GCond cond;
+	atomic_bool failed;
+};
+
+// once an operation asks to stop, the ones still queued are dropped
+static void* applyShardProc(ApplyShard* sh) {
+	Applier* ap = sh->ap;
+	for (ApplyOp* op; (op = g_async_queue_pop(sh->queue)) != (ApplyOp*)ap;) {
+		if (!atomic_load_explicit(&ap->failed, memory_order_relaxed) && !ap->func(ap->data, sh->id, op))
+			atomic_store_explicit(&ap->failed, true, memory_order_relaxed);
+		free(op);
+
+		g_mutex_lock(&ap->mutex);
+		if (--ap->pending == 0 || ap->pending == APPLIER_QUEUE_MAX - 1)
+			g_cond_broadcast(&ap->cond);
+		g_mutex_unlock(&ap->mutex);
+	}
+	return NULL;
+}
+
+Applier* startApplier(size_t shards, ApplyFunc func, void* data) {
+	Applier* ap = malloc(sizeof(Applier));
+	ap->shards = malloc(shards * sizeof(ApplyShard));
+	ap->dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	ap->owners = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	ap->func = func;
+	ap->data = data;
+	ap->lastSrc = ap->lastDst = NULL;
+	ap->lastSrcLen = ap->lastDstLen = 0;
+	ap->lastShard = 0;
+	ap->nShards = shards;
+	ap->pending = 0;
+	g_mutex_init(&ap->mutex);
+	g_cond_init(&ap->cond);
+	atomic_init(&ap->failed, false);
+	for (size_t i = 0; i < shards; ++i) {
+		ap->shards[i].ap = ap;
+		ap->shards[i].id = i;
+		ap->shards[i].queue = g_async_queue_new();
+		ap->shards[i].thread = g_thread_new("apply", (GThreadFunc)applyShardProc, &ap->shards[i]);
+	}
+	return ap;
+}
+
+static size_t hashDirectory(const char* dir, size_t dlen) {
+	size_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < dlen; ++i)
+		hash = (hash ^ (uchar)dir[i]) * 1099511628211ULL;
+	return hash;
+}
+
+// a directory and all of its parents are remembered, so that renaming any of them waits for the files queued inside
+static const char* addDirectory(Applier* ap, const char* dir, size_t dlen) {
+	const char* last = NULL;
+	for (size_t len = dlen; len;) {
+		char* key = g_strndup(dir, len);
+		const char* old;
+		if (g_hash_table_lookup_extended(ap->dirs, key, (gpointer*)&old, NULL)) {
+			g_free(key);
+			if (!last)
+				last = old;
+			break;
+		}
+		g_hash_table_add(ap->dirs, key);
+		if (!last)
+			last = key;
+
+		const char* sep = memrchr(dir, '/', len * sizeof(char));
+		len = sep ? (size_t)(sep - dir) : 0;
+	}
+	return last;
+}
+
+static size_t parentLength(const char* path, size_t plen) {
+	const char* sep = memrchr(path, '/', plen * sizeof(char));
+	return sep ? (size_t)(sep - path) : 0;
+}
+
+static bool sameDirectory(const char* last, size_t lastLen, const char* dir, size_t dlen) {
+	return last && lastLen == dlen && !memcmp(last, dir, dlen * sizeof(char));
+}
+
+// a directory belongs to the shard that got the first file from or into it, so that everything touching it keeps its order
+static void pickShard(Applier* ap, const char* src, size_t sdirLen, const char* dst, size_t ddirLen) {
+	char* skey = g_strndup(src, sdirLen);
+	char* dkey = g_strndup(dst, ddirLen);
+	size_t sown = GPOINTER_TO_SIZE(g_hash_table_lookup(ap->owners, skey));
+	size_t down = GPOINTER_TO_SIZE(g_hash_table_lookup(ap->owners, dkey));
+	if (sown && down && sown != down) {
+		// a file moving between directories of different shards has to wait for both of them
+		drainApplier(ap);
+		sown = down = 0;
+	}
+	ap->lastShard = sown ? sown - 1 : down ? down - 1 : hashDirectory(src, sdirLen) % ap->nShards;
+	g_hash_table_replace(ap->owners, skey, GSIZE_TO_POINTER(ap->lastShard + 1));
+	g_hash_table_replace(ap->owners, dkey, GSIZE_TO_POINTER(ap->lastShard + 1));
+	ap->lastSrc = addDirectory(ap, src, sdirLen);
+	ap->lastSrcLen = sdirLen;
+	ap->lastDst = addDirectory(ap, dst, ddirLen);
+	ap->lastDstLen = ddirLen;
+}
+
+// files are sharded by their source and destination directories, so that renames in one directory keep their order while different directories go on in parallel
+void queueApply(Applier* ap, size_t id, const char* src, size_t slen, const char* dst, size_t dlen) {
+	if (g_hash_table_size(ap->dirs) && g_hash_table_contains(ap->dirs, src))
+		drainApplier(ap);
+
+	size_t sdirLen = parentLength(src, slen);
+	size_t ddirLen = parentLength(dst, dlen);
+	// consecutive files usually share their directories, which spares the lookups for most of them
+	if (!sameDirectory(ap->lastSrc, ap->lastSrcLen, src, sdirLen) || !sameDirectory(ap->lastDst, ap->lastDstLen, dst, ddirLen))
+		pickShard(ap, src, sdirLen, dst, ddirLen);
+
+	ApplyOp* op = malloc(sizeof(ApplyOp) + (slen + dlen + 2) * sizeof(char));
+	op->id = id;
+	memcpy(op->src, src, slen * sizeof(char));
+	op->src[slen] = '\0';
+	op->dst = op->src + slen + 1;
+	memcpy(op->dst, dst, dlen * sizeof(char));
+	op->dst[dlen] = '\0';
+
+	// the queues are bounded so that a slow filesystem doesn't pile up the whole input in memory
+	g_mutex_lock(&ap->mutex);
+	while (ap->pending >= APPLIER_QUEUE_MAX)
+		g_cond_wait(&ap->cond, &ap->mutex);
+	++ap->pending;
+	g_mutex_unlock(&ap->mutex);
+	g_async_queue_push(ap->shards[ap->lastShard].queue, op);
+}
+
+bool drainApplier(Applier* ap) {
+	g_mutex_lock(&ap->mutex);
+	while (ap->pending)
+		g_cond_wait(&ap->cond, &ap->mutex);
+	g_mutex_unlock(&ap->mutex);
+	g_hash_table_remove_all(ap->dirs);
+	g_hash_table_remove_all(ap->owners);
+	ap->lastSrc = ap->lastDst = NULL;
+	return !applierFailed(ap);
+}
+
+bool applierFailed(const Applier* ap) {
+	return atomic_load_explicit(&ap->failed, memory_order_relaxed);
+}
+
+bool stopApplier(Applier* ap) {
+	for (size_t i = 0; i < ap->nShards; ++i)
+		g_async_queue_push(ap->shards[i].queue, ap);
+	for (size_t i = 0; i < ap->nShards; ++i) {
+		g_thread_join(ap->shards[i].thread);
+		g_async_queue_unref(ap->shards[i].queue);
+	}
+	bool ok = !applierFailed(ap);
+	g_hash_table_destroy(ap->dirs);
+	g_hash_table_destroy(ap->owners);
+	g_cond_clear(&ap->cond);
+	g_mutex_clear(&ap->mutex);
+	free(ap->shards);
+	free(ap);
+	return ok;
+}
@@ -0,0 +1,24 @@
+#ifndef APPLIER_H
+#define APPLIER_H
+
+#include "utils.h"
+
+#define APPLIER_SHARDS_MAX 64
+
+typedef struct Applier Applier;
+
+typedef struct ApplyOp {
+	size_t id;
+	char* dst;
+	char src[];
+} ApplyOp;
+
+typedef bool (*ApplyFunc)(void* data, size_t shard, const ApplyOp* op);
+
+Applier* startApplier(size_t shards, ApplyFunc func, void* data);
+void queueApply(Applier* ap, size_t id, const char* src, size_t slen, const char* dst, size_t dlen);
+bool drainApplier(Applier* ap);
+bool applierFailed(const Applier* ap);
+bool stopApplier(Applier* ap);
+
+#endif
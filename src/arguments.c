@@ -1,4 +1,8 @@
+#include "applier.h"
 #include "arguments.h"
+#include "pipeline.h"
+#include "plan.h"
+#include "retry.h"
 
 #ifdef _WIN32
 #define INVALID_FNCHARS "\"*/:<>?\\|\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1A\x1B\x1C\x1D\x1E\x1F"
@@ -6,6 +10,9 @@
 #define INVALID_FNCHARS "/"
 #endif
 
+#define ARGUMENTS_PARAMETER "[FILE\xE2\x80\xA6]"
+#define ARGUMENTS_SUMMARY "Simple Fucking Bulk Rename: A small tool for batch renaming files."
+
 char* validateFilename(const char* name) {
 	size_t len = strcspn(name, INVALID_FNCHARS);
 	if (!name[len])
@@ -108,11 +115,41 @@ static DestinationMode parseDestinationMode(gchar* mode) {
 		dm = DESTINATION_COPY;
 	else if (id == DESTINATION_LINK || !strcasecmp(mode, "l") || !strcasecmp(mode, "link"))
 		dm = DESTINATION_LINK;
+	else if (id == DESTINATION_HARDLINK || !strcasecmp(mode, "h") || !strcasecmp(mode, "hardlink"))
+		dm = DESTINATION_HARDLINK;
 	g_free(mode);
 	return dm;
 }
 
-void processArgumentOptions(Arguments* arg) {
+static OutputFormat parseOutputFormat(gchar* format) {
+	if (!format)
+		return OUTPUT_TEXT;
+
+	OutputFormat of = OUTPUT_TEXT;
+	if (!strcasecmp(format, "nul") || !strcasecmp(format, "null"))
+		of = OUTPUT_NUL;
+	else if (!strcasecmp(format, "json"))
+		of = OUTPUT_JSON;
+	g_free(format);
+	return of;
+}
+
+static CollisionMode parseCollisionMode(gchar* mode) {
+	if (!mode)
+		return COLLISION_OVERWRITE;
+
+	CollisionMode cm = COLLISION_OVERWRITE;
+	if (!strcasecmp(mode, "skip"))
+		cm = COLLISION_SKIP;
+	else if (!strcasecmp(mode, "suffix"))
+		cm = COLLISION_SUFFIX;
+	else if (!strcasecmp(mode, "number"))
+		cm = COLLISION_NUMBER;
+	g_free(mode);
+	return cm;
+}
+
+bool processArgumentOptions(Arguments* arg, GError** err) {
 	arg->extensionMode = parseRenameMode(arg->extensionModeStr, &arg->extensionName, &arg->extensionReplace);
 	arg->extensionElements = CLAMP(arg->extensionElements, -1, FILENAME_MAX - 1);
 	arg->renameMode = parseRenameMode(arg->renameModeStr, &arg->rename, &arg->replace);
@@ -145,14 +182,28 @@ void processArgumentOptions(Arguments* arg) {
 
 	arg->destinationMode = parseDestinationMode(arg->destinationModeStr);
 	checkArgName(&arg->destination, false);
+	arg->syncEvery = MAX(arg->syncEvery, 0);
+	arg->planShards = CLAMP(arg->planShards, 0, PLAN_SHARDS_MAX);
+	arg->maxDepth = MAX(arg->maxDepth, -1);
+	arg->computeThreads = CLAMP(arg->computeThreads, 0, PIPELINE_WORKERS_MAX);
+	arg->applyThreads = CLAMP(arg->applyThreads, 0, APPLIER_SHARDS_MAX);
+	arg->outputFormat = parseOutputFormat(arg->outputStr);
+	arg->collisionMode = parseCollisionMode(arg->collisionStr);
+	arg->retryLimit = CLAMP(arg->retryLimit, 0, RETRY_LIMIT_MAX);
+	arg->maxOpsPerSec = MAX(arg->maxOpsPerSec, 0);
+	arg->maxBytesPerSec = MAX(arg->maxBytesPerSec, 0);
+	// a policy that can't be read would otherwise decide errors differently than asked
+	return parseErrorPolicy(&arg->errorPolicy, arg->errorPolicyStr, err);
 }
 
-void initCommandLineArguments(GApplication* app, Arguments* arg, int argc, char** argv) {
+static GOptionEntry* newOptionEntries(Arguments* arg) {
 	arg->extensionElements = -1;
 	arg->numberLocation = -1;
 	arg->numberBase = 10;
 	arg->numberPadding = 1;
 	arg->dateLocation = -1;
+	arg->maxDepth = -1;
+	arg->retryLimit = RETRY_LIMIT_DEFAULT;
 
 	const char* extMsg = "\n\tSet how to change a filename's extension.\n\n"
 "1. Replace the extension with the string set by --extension-name.\n   This option is set with \"rename\", \"n\" or \"1\".\n"
@@ -185,7 +236,7 @@ void initCommandLineArguments(GApplication* app, Arguments* arg, int argc, char*
 		{ "date-mode", 'e', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->dateModeStr, "\n\tSet whether to insert the file's modification, access or status change date.\n\tThis option can be set with \"modify\", \"access\", \"change\", their first letters or indices 0 - 3.\n\tDefault value is 0.\n", "MODE" },
 		{ "date-format", 'F', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->dateFormat, "\n\tHow the date will be formatted.\n\tDefault value is " DEFAULT_DATE_FORMAT "\".\n", "STRING" },
 		{ "date-location", 'O', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->dateLocation, "\n\tAn index where to insert a date into a filename.\n\tA negative index can be used to set a location relative to a filename's length.\n\tDefault value is -1.\n", "INDEX" },
-		{ "destination-mode", 'D', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->destinationModeStr, "\n\tSet whether to rename the files in place, move them, copy them or create symlinks to them.\n\tThis option can be set with \"in-place\", \"move\", \"copy\", \"link\", their first letters or indices 0 - 3.\n\tDefault value is 0.\n", "MODE" },
+		{ "destination-mode", 'D', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->destinationModeStr, "\n\tSet whether to rename the files in place, move them, copy them, create symlinks or create hardlinks to them.\n\tHardlinks fall back to copying when the destination is on a different filesystem.\n\tThis option can be set with \"in-place\", \"move\", \"copy\", \"link\", \"hardlink\", their first letters or indices 0 - 4.\n\tDefault value is 0.\n", "MODE" },
 		{ "destination", 'd', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->destination, "\n\tSet the destination directory when --destination-mode isn't set to \"in place\".\n", "DIRECTORY" },
 		{ "extension-mode", 'M', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->extensionModeStr, extMsg, "MODE" },
 		{ "extension-name", 'N', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->extensionName, "\n\tReplace the extension of a filename with this string.\n\tIf --extension-mode is set to \"replace\" this string will be replaced by the string set with --extension-replace.\n\tImplies \"--extension-mode rename\" if --extension-mode isn't set to \"replace\".\n", "STRING" },
@@ -211,19 +262,120 @@ void initCommandLineArguments(GApplication* app, Arguments* arg, int argc, char*
 		{ "rename-replace", 'r', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->replace, "\n\tReplace the string set by --rename-name with this string.\n\tImplies \"--rename-mode replace\".\n", "STRING" },
 		{ "rename-case", 'i', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->replaceCi, "\n\tDo a case insensitive search when --rename-mode is set to \"replace\".\n", NULL },
 		{ "rename-regex", 'x', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->replaceRegex, "\n\tUse the string set by --rename-name as a regular expression when --rename-mode is set to \"replace\".\n", NULL },
+		{ "verify", 'V', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->verify, "\n\tHash the data of copied files while it's being written and compare it against the files read back from the destination.\n\tFiles that don't match are listed once all copies are finished.\n", NULL },
+		{ "progress", 'w', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->progress, "\n\tShow the amount of copied data, the throughput and the estimated remaining time when --destination-mode is set to \"copy\".\n", NULL },
+		{ "journal", 'J', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->journal, "\n\tAppend every successful rename to this file, so that it can be reverted with --undo.\n", "FILE" },
+		{ "undo", 'U', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->undo, "\n\tRevert all renames recorded in this journal file, starting with the latest one.\n\tMoved files are moved back and copies or links are removed while their original still exists.\n\tImplies --no-gui and ignores all other files and rename options.\n", "FILE" },
+		{ "checkpoint", 'Q', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->checkpoint, "\n\tPeriodically save the position of a --no-gui run to this file and once more when it's interrupted by SIGINT or SIGTERM.\n\tThe file is removed after all files have been processed.\n\tCan't be used with --recursive when the files are renamed in place or moved.\n", "FILE" },
+		{ "resume", 'q', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->resume, "\n\tContinue from the position saved in the file set by --checkpoint.\n\tThe same files and options have to be passed as in the interrupted run.\n", NULL },
+		{ "durable", 'W', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->durable, "\n\tMake the new names durable by syncing every directory that was changed once all files have been processed.\n", NULL },
+		{ "sync-every", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->syncEvery, "\n\tAlso sync the changed directories after this many files.\n\tImplies --durable.\n", "NUMBER" },
+		{ "syncfs", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->syncfs, "\n\tSync each changed filesystem as a whole instead of every directory, which is faster for very large batches.\n\tImplies --durable.\n", NULL },
+		{ "plan-out", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->planOut, "\n\tWrite the computed renames into this file instead of applying them, so that they can be reviewed and applied later with --plan-in.\n\tThe renames are ordered so that no file takes a name before its previous owner has moved away, where a cycle of names is broken by parking one file under a temporary name that's checked again when the plan is applied.\n\tRenames that are applied right away, including those of the GUI, run in the order of the files, so a swap or shift of names overwrites files there unless --on-collision keeps them.\n\tImplies --no-gui.\n", "FILE" },
+		{ "plan-in", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->planIn, "\n\tApply the renames from a file written by --plan-out.\n\tNothing is renamed if any of the files has been replaced or removed since the plan was made, or if any new name is too long, taken twice, already exists, lies in a directory that isn't writable or doesn't fit on its file system.\n\tImplies --no-gui and ignores all other files and rename options.\n", "FILE" },
+		{ "plan-shards", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->planShards, "\n\tSplit the plan set by --plan-in into this many files named after it with the shard's index appended instead of applying it.\n\tRenames that share a source or destination directory, also through other renames, always end up in the same shard, so the shards can be applied at the same time.\n\tNo shards are left behind when one can't be written.\n", "NUMBER" },
+		{ "merge-journal", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->mergeJournal, "\n\tAppend the records of all journal files passed as arguments to this journal, e.g. to undo the renames of several shards at once.\n\tImplies --no-gui.\n", "FILE" },
+		{ "files-from", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->filesFrom, "\n\tRead the files to process from this list with one path per line instead of the arguments, or from standard input if set to \"-\".\n\tThe list is processed while it's being read, so it can be of any length, but it can't be combined with --backwards.\n", "FILE" },
+		{ "null", '0', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->nullData, "\n\tPaths in the list set by --files-from are separated by NUL characters instead of newlines.\n", NULL },
+		{ "input-meta", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->inputMeta, "\n\tEntries in the list set by --files-from start with the size, modification time, status change time, user ID and inode of the file separated by tabs, like the output of find -printf '%s\\t%T@\\t%C@\\t%U\\t%i\\t%p\\n'.\n\tThese values are used for the modification or change date and the file details instead of reading them from the filesystem, while the inode column is skipped.\n", NULL },
+		{ "recursive", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->recursive, "\n\tAlso process everything inside the directories that are passed as arguments or listed by --files-from.\n\tEntries are processed in alphabetical order and a directory always comes after its contents.\n\tIt can't be combined with --backwards.\n", NULL },
+		{ "max-depth", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->maxDepth, "\n\tDon't descend more than this many directories below a passed directory with --recursive.\n\tA value of 0 only processes the passed files themselves.\n", "NUMBER" },
+		{ "one-file-system", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->oneFileSystem, "\n\tDon't descend into directories on other filesystems with --recursive.\n", NULL },
+		{ "files-only", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->filesOnly, "\n\tOnly process entries that aren't directories with --recursive.\n", NULL },
+		{ "dirs-only", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &arg->dirsOnly, "\n\tOnly process directories with --recursive.\n", NULL },
+		{ "include", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING_ARRAY, &arg->include, "\n\tOnly process files whose name matches this pattern, which can contain the wildcards *, ? and [...].\n\tA pattern that ends with a slash only matches directories.\n\tCan be set multiple times and also applies to the entries found by --recursive.\n", "PATTERN" },
+		{ "exclude", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING_ARRAY, &arg->exclude, "\n\tDon't process files whose name matches this pattern and don't descend into matching directories with --recursive.\n\tA pattern that ends with a slash only matches directories.\n\tCan be set multiple times.\n", "PATTERN" },
+		{ "rules", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->rules, "\n\tMake the new names with the options of the first rule set in this key file that matches a file.\n\tEvery group is a rule set, which can have lists of name patterns under \"match\" and \"exclude\", sizes in bytes under \"min-size\" and \"max-size\" and its rename options under \"options\", where only the --add, --date, --extension, --number, --remove and --rename options are accepted.\n\tFiles that don't match any rule set are renamed with the options passed to the command line, which also decide where and how all files are renamed.\n\tImplies --no-gui.\n", "FILE" },
+		{ "output", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->outputStr, "\n\tSet how the renamed files are listed by --dry, --verbose and --undo.\n\t\"text\" prints quoted names with an arrow between them, \"nul\" prints the old and new path each followed by a NUL character and \"json\" prints an object with \"src\" and \"dst\" per line.\n\tRemoved files have an empty or null destination.\n\tDefault value is \"text\".\n", "FORMAT" },
+		{ "compute-threads", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->computeThreads, "\n\tMake the new names on this many threads, while another thread reads the files and the renames are applied in order as soon as their names are ready.\n\tOnly one thread is used with --rules.\n\tA value of 0 processes the files one after another.\n\tDefault value is 0.\n", "NUMBER" },
+		{ "apply-threads", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->applyThreads, "\n\tApply the renames on this many threads, where the files of one directory are always renamed by the same thread in their original order.\n\tCopies and hard links are still applied one after another.\n\tA value of 0 applies the renames on the main thread.\n\tDefault value is 0.\n", "NUMBER" },
+		{ "on-collision", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->collisionStr, "\n\tSet what happens when a new name has already been given to another file of the run or already exists in the destination, where a file keeping its own name doesn't count.\n\t\"overwrite\" renames the file anyway, \"skip\" leaves it as it is, \"suffix\" appends \" (2)\", \" (3)\" and so on and \"number\" appends \"_2\", \"_3\" and so on before the extension.\n\tDefault value is \"overwrite\".\n", "MODE" },
+		{ "on-error", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->errorPolicyStr, "\n\tDecide per error without asking, with a comma separated list like \"ENOENT=skip,EBUSY=retry,*=collect\", where \"*\" stands for all other errors.\n\t\"skip\" goes on with the next file, \"abort\" stops, \"retry\" tries again up to --retry-limit times, \"overwrite\" removes a file or empty directory in the way and \"collect\" goes on and lists the file in the error report.\n\tA name that gets too long counts as ENAMETOOLONG and one that can't be made unique as EEXIST.\n\tErrors without a policy are handled like before and an invalid policy is refused.\n", "POLICY" },
+		{ "error-report", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &arg->errorReport, "\n\tWrite the errors collected by --on-error into this file, one tab separated line of source, destination, error name and message per file, instead of printing them.\n", "FILE" },
+		{ "retry-limit", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->retryLimit, "\n\tTry a rename that failed with EBUSY, ESTALE or EAGAIN up to this many more times, waiting twice as long each time starting at about 100 milliseconds.\n\tThe retries are made on another thread while the other files go on, and a later rename of the same path waits for them.\n\tA value of 0 handles these errors like any other.\n\tDefault value is 5.\n", "NUMBER" },
+		{ "max-ops-per-sec", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->maxOpsPerSec, "\n\tApply at most this many renames, links or copies per second, shared by all threads and retries.\n\tA value of 0 doesn't limit them.\n\tDefault value is 0.\n", "NUMBER" },
+		{ "max-bytes-per-sec", '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &arg->maxBytesPerSec, "\n\tCopy and verify at most this many bytes per second, shared by all threads.\n\tA value of 0 doesn't limit them.\n\tDefault value is 0.\n", "BYTES" },
 		{ NULL, '\0', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL, NULL, NULL }
 	};
+	// the option groups copy the entries, so they only need to outlive the call that adds them
+	return memcpy(malloc(sizeof(params)), params, sizeof(params));
+}
+
+static void scanNumberOptions(Arguments* arg, const GOptionEntry* params, int argc, char** argv) {
 	const int nid = 18;
 	for (int i = 1; i < argc; ++i)
 		for (int j = 0; j < 8; ++j)
 			if ((argv[i][0] == '-' && argv[i][1] == params[j + nid].short_name && !argv[i][2]) || (!strncmp(argv[i], "--", 2) && !strcmp(argv[i] + 2, params[j + nid].long_name))) {
 				arg->number = true;
-				goto loopEnd;
+				return;
 			}
-loopEnd:
+}
+
+// parsing argv directly leaves the file arguments in place, so they don't need to be copied
+GOptionContext* initCommandLineContext(Arguments* arg, int argc, char** argv) {
+	GOptionEntry* params = newOptionEntries(arg);
+	scanNumberOptions(arg, params, argc, argv);
+	GOptionContext* ctx = g_option_context_new(ARGUMENTS_PARAMETER);
+	g_option_context_add_main_entries(ctx, params, NULL);
+	g_option_context_set_summary(ctx, ARGUMENTS_SUMMARY);
+	free(params);
+	return ctx;
+}
+
+#ifndef CONSOLE
+void initCommandLineArguments(GApplication* app, Arguments* arg, int argc, char** argv) {
+	GOptionEntry* params = newOptionEntries(arg);
+	scanNumberOptions(arg, params, argc, argv);
 	g_application_add_main_option_entries(app, params);
-	g_application_set_option_context_parameter_string(app, "[FILE\xE2\x80\xA6]");
-	g_application_set_option_context_summary(app, "Simple Fucking Bulk Rename: A small tool for batch renaming files.");
+	g_application_set_option_context_parameter_string(app, ARGUMENTS_PARAMETER);
+	g_application_set_option_context_summary(app, ARGUMENTS_SUMMARY);
+	free(params);
+}
+#endif
+
+static bool isNamingOption(const char* name) {
+	static const char* const prefixes[] = { "add-", "date-", "extension-", "number-", "remove-", "rename-" };
+	for (size_t i = 0; i < G_N_ELEMENTS(prefixes); ++i)
+		if (!strncmp(name, prefixes[i], strlen(prefixes[i])))
+			return true;
+	return false;
+}
+
+// only the options that make a name are known here, since everything else is set for the whole run
+static void keepNamingOptions(GOptionEntry* params) {
+	GOptionEntry* out = params;
+	for (; params->long_name; ++params)
+		if (isNamingOption(params->long_name))
+			*out++ = *params;
+	*out = *params;
+}
+
+bool parseArgumentString(Arguments* arg, const char* options, GError** err) {
+	// the string is split like a shell command, whose first word is skipped as the program name
+	char* cmd = g_strconcat("sfbrename ", options, NULL);
+	char** argv;
+	int argc;
+	bool ok = g_shell_parse_argv(cmd, &argc, &argv, err);
+	g_free(cmd);
+	if (!ok)
+		return false;
+
+	GOptionEntry* params = newOptionEntries(arg);
+	scanNumberOptions(arg, params, argc, argv);
+	keepNamingOptions(params);
+	GOptionContext* ctx = g_option_context_new(NULL);
+	g_option_context_set_help_enabled(ctx, FALSE);
+	g_option_context_add_main_entries(ctx, params, NULL);
+	ok = g_option_context_parse_strv(ctx, &argv, err);
+	if (ok && argv[1]) {
+		g_set_error(err, G_OPTION_ERROR, G_OPTION_ERROR_FAILED, "Unexpected argument '%s'", argv[1]);
+		ok = false;
+	}
+	ok = ok && processArgumentOptions(arg, err);
+	g_option_context_free(ctx);
+	free(params);
+	g_strfreev(argv);
+	return ok;
 }
 
 void freeArguments(Arguments* arg) {
@@ -241,4 +393,15 @@ void freeArguments(Arguments* arg) {
 	g_free(arg->numberSuffix);
 	g_free(arg->dateFormat);
 	g_free(arg->destination);
+	g_free(arg->journal);
+	g_free(arg->undo);
+	g_free(arg->checkpoint);
+	g_free(arg->planOut);
+	g_free(arg->planIn);
+	g_free(arg->mergeJournal);
+	g_free(arg->filesFrom);
+	g_strfreev(arg->include);
+	g_strfreev(arg->exclude);
+	g_free(arg->rules);
+	g_free(arg->errorReport);
 }
@@ -1,7 +1,7 @@
 #ifndef ARGUMENTS_H
 #define ARGUMENTS_H
 
-#include "utils.h"
+#include "policy.h"
 
 typedef struct Arguments {
 	char* extensionModeStr;
@@ -22,6 +22,20 @@ typedef struct Arguments {
 	char* dateFormat;
 	char* destinationModeStr;
 	char* destination;
+	char* journal;
+	char* undo;
+	char* checkpoint;
+	char* planOut;
+	char* planIn;
+	char* mergeJournal;
+	char* filesFrom;
+	char** include;
+	char** exclude;
+	char* rules;
+	char* outputStr;
+	char* collisionStr;
+	char* errorPolicyStr;
+	char* errorReport;
 	int64_t extensionElements;
 	int64_t removeFrom;
 	int64_t removeTo;
@@ -34,6 +48,14 @@ typedef struct Arguments {
 	int64_t numberBase;
 	int64_t numberPadding;
 	int64_t dateLocation;
+	int64_t syncEvery;
+	int64_t planShards;
+	int64_t maxDepth;
+	int64_t computeThreads;
+	int64_t applyThreads;
+	int64_t retryLimit;
+	int64_t maxOpsPerSec;
+	int64_t maxBytesPerSec;
 	gboolean extensionCi;
 	gboolean extensionRegex;
 	gboolean replaceCi;
@@ -45,17 +67,35 @@ typedef struct Arguments {
 	gboolean verbose;
 	gboolean msgAbort;
 	gboolean msgContinue;
+	gboolean verify;
+	gboolean progress;
+	gboolean resume;
+	gboolean durable;
+	gboolean syncfs;
+	gboolean nullData;
+	gboolean inputMeta;
+	gboolean recursive;
+	gboolean oneFileSystem;
+	gboolean filesOnly;
+	gboolean dirsOnly;
 
 	RenameMode extensionMode;
 	RenameMode renameMode;
 	DateMode dateMode;
 	DestinationMode destinationMode;
+	OutputFormat outputFormat;
+	CollisionMode collisionMode;
+	ErrorPolicy errorPolicy;
 	bool number;
 } Arguments;
 
 char* validateFilename(const char* name);
-void processArgumentOptions(Arguments* arg);
+bool processArgumentOptions(Arguments* arg, GError** err);
+GOptionContext* initCommandLineContext(Arguments* arg, int argc, char** argv);
+#ifndef CONSOLE
 void initCommandLineArguments(GApplication* app, Arguments* arg, int argc, char** argv);
+#endif
+bool parseArgumentString(Arguments* arg, const char* options, GError** err);
 void freeArguments(Arguments* arg);
 
 #endif
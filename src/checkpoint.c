@@ -0,0 +1,125 @@
+#include "checkpoint.h"
+#include "rename.h"
+#include "verify.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define CHECKPOINT_MAGIC 0x43424653
+#define CHECKPOINT_VERSION 2
+
+typedef struct CheckpointData {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t inputHash;
+	uint64_t total;
+	uint64_t next;
+	int64_t numberStart;
+	int64_t numberStep;
+	uint8_t forward;
+} CheckpointData;
+
+static volatile sig_atomic_t interrupted = 0;
+
+uint64_t hashInputFiles(char** paths, size_t nPaths) {
+	HashState hs;
+	hashInit(&hs);
+	for (size_t i = 0; i < nPaths; ++i)
+		hashUpdate(&hs, paths[i], strlen(paths[i]) + 1);
+	return hashDigest(&hs);
+}
+
+// the rule sets number their files on their own, so their positions follow the fixed part from version 2 on
+// a streamed list can only be checked after skipping what's done, so without check the saved hash is handed back instead
+bool loadCheckpoint(Process* prc, const char* path, uint64_t* inputHash, bool check, uint64_t* ruleIds, size_t nRules) {
+	FILE* fd = fopen(path, "rb");
+	if (!fd) {
+		if (errno == ENOENT)
+			return true;
+		showMessage(NULL, MESSAGE_ERROR, BUTTONS_OK, "Failed to open checkpoint '%s': %s", path, strerror(errno));
+		return false;
+	}
+
+	CheckpointData cp;
+	uint64_t cnt = 0;
+	bool ok = fread(&cp, sizeof(cp), 1, fd) == 1 && cp.magic == CHECKPOINT_MAGIC && cp.version <= CHECKPOINT_VERSION;
+	if (ok && cp.version >= 2) {
+		ok = fread(&cnt, sizeof(cnt), 1, fd) == 1;
+		if (ok && cnt == nRules && nRules)
+			ok = fread(ruleIds, sizeof(uint64_t), nRules, fd) == nRules;
+	}
+	fclose(fd);
+	if (!ok) {
+		showMessage(NULL, MESSAGE_ERROR, BUTTONS_OK, "'%s' is not a valid checkpoint", path);
+		return false;
+	}
+	if ((check && cp.inputHash != *inputHash) || cp.total != prc->total || cp.forward != prc->forward || cp.numberStart != prc->numberStart || cp.numberStep != prc->numberStep || cnt != nRules) {
+		showMessage(NULL, MESSAGE_ERROR, BUTTONS_OK, "Checkpoint '%s' was made for different files or options", path);
+		return false;
+	}
+	prc->id = cp.next;
+	*inputHash = cp.inputHash;
+	return true;
+}
+
+bool saveCheckpoint(const Process* prc, const char* path, uint64_t inputHash, const uint64_t* ruleIds, size_t nRules) {
+	CheckpointData cp = {
+		.magic = CHECKPOINT_MAGIC,
+		.version = CHECKPOINT_VERSION,
+		.inputHash = inputHash,
+		.total = prc->total,
+		.next = prc->id,
+		.numberStart = prc->numberStart,
+		.numberStep = prc->numberStep,
+		.forward = prc->forward
+	};
+	size_t plen = strlen(path);
+	char* tmp = malloc((plen + 5) * sizeof(char));
+	memcpy(tmp, path, plen * sizeof(char));
+	strcpy(tmp + plen, ".tmp");
+
+	// the old checkpoint is only replaced once the new one is complete, so a crash during the write loses nothing
+	FILE* fd = fopen(tmp, "wb");
+	uint64_t cnt = nRules;
+	bool ok = fd && fwrite(&cp, sizeof(cp), 1, fd) == 1 && fwrite(&cnt, sizeof(cnt), 1, fd) == 1 && (!nRules || fwrite(ruleIds, sizeof(uint64_t), nRules, fd) == nRules) && !fflush(fd);
+#ifndef _WIN32
+	ok = ok && !fsync(fileno(fd));
+#endif
+	if (fd)
+		ok = !fclose(fd) && ok;
+	if (ok) {
+#ifdef _WIN32
+		wchar_t* wtmp = stow(tmp);
+		wchar_t* wpath = stow(path);
+		ok = MoveFileExW(wtmp, wpath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+		free(wtmp);
+		free(wpath);
+#else
+		ok = !rename(tmp, path);
+#endif
+	}
+	if (!ok) {
+		showMessage(NULL, MESSAGE_ERROR, BUTTONS_OK, "Failed to write checkpoint '%s': %s", path, strerror(errno));
+		remove(tmp);
+	}
+	free(tmp);
+	return ok;
+}
+
+static void handleInterrupt(int sig) {
+	interrupted = sig;
+}
+
+void catchInterrupts(void) {
+	signal(SIGINT, handleInterrupt);
+	signal(SIGTERM, handleInterrupt);
+}
+
+bool interruptCaught(void) {
+	return interrupted;
+}
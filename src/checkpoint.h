@@ -0,0 +1,14 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "utils.h"
+
+#define CHECKPOINT_INTERVAL 1024
+
+uint64_t hashInputFiles(char** paths, size_t nPaths);
+bool loadCheckpoint(Process* prc, const char* path, uint64_t* inputHash, bool check, uint64_t* ruleIds, size_t nRules);
+bool saveCheckpoint(const Process* prc, const char* path, uint64_t inputHash, const uint64_t* ruleIds, size_t nRules);
+void catchInterrupts(void);
+bool interruptCaught(void);
+
+#endif
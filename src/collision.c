@@ -0,0 +1,113 @@
+#include "collision.h"
+#include <dirent.h>
+
+#define MAX_DIGITS_U64 20
+#define NAME_CLAIMED 1
+
+struct NameIndex {
+	GHashTable* dirs;
+	GHashTable* last;
+	const char* lastDir;
+	size_t lastDirLen;
+};
+
+NameIndex* newNameIndex(void) {
+	NameIndex* idx = malloc(sizeof(NameIndex));
+	idx->dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_hash_table_destroy);
+	idx->last = NULL;
+	idx->lastDir = NULL;
+	idx->lastDirLen = 0;
+	return idx;
+}
+
+// files that are already in a destination directory count as taken, including the other inputs of an in place run, which may not have been renamed yet
+static GHashTable* indexDirectory(NameIndex* idx, const char* dir, size_t dlen) {
+	if (idx->last && idx->lastDirLen == dlen && !memcmp(idx->lastDir, dir, dlen * sizeof(char)))
+		return idx->last;
+
+	char* key = g_strndup(dir, dlen);
+	const char* old;
+	GHashTable* names;
+	if (g_hash_table_lookup_extended(idx->dirs, key, (gpointer*)&old, (gpointer*)&names))
+		g_free(key);
+	else {
+		names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		DIR* dp = opendir(dlen ? key : ".");
+		if (dp) {
+			for (struct dirent* entry = readdir(dp); entry; entry = readdir(dp))
+				g_hash_table_insert(names, g_strdup(entry->d_name), GSIZE_TO_POINTER(0));
+			closedir(dp);
+		}
+		g_hash_table_insert(idx->dirs, key, names);
+		old = key;
+	}
+	idx->last = names;
+	idx->lastDir = old;
+	idx->lastDirLen = dlen;
+	return names;
+}
+
+static size_t numberName(char* dst, const char* name, size_t nameLen, size_t num, CollisionMode mode) {
+	const char* ext = nameLen > 1 ? memchr(name + 1, '.', (nameLen - 1) * sizeof(char)) : NULL;
+	size_t blen = ext ? (size_t)(ext - name) : nameLen;
+	char mark[MAX_DIGITS_U64 + 4];
+	int mlen = snprintf(mark, sizeof(mark), mode == COLLISION_SUFFIX ? " (%zu)" : "_%zu", num);
+	if (nameLen + mlen >= FILENAME_MAX)
+		return SIZE_MAX;
+
+	memcpy(dst, name, blen * sizeof(char));
+	memcpy(dst + blen, mark, mlen * sizeof(char));
+	memcpy(dst + blen + mlen, name + blen, (nameLen - blen + 1) * sizeof(char));
+	return nameLen + mlen;
+}
+
+// every taken name remembers the next number to try, so that a million files with the same name don't each probe all of the numbers before them
+size_t claimName(NameIndex* idx, const char* dir, size_t dlen, char* name, size_t nameLen, const char* own, size_t ownLen, CollisionMode mode) {
+	GHashTable* names = indexDirectory(idx, dir, dlen);
+	gpointer val;
+	bool found = g_hash_table_lookup_extended(names, name, NULL, &val);
+	size_t next = GPOINTER_TO_SIZE(val) >> 1;
+	bool claimed = GPOINTER_TO_SIZE(val) & NAME_CLAIMED;
+	// a file that keeps its name only clashes with itself, as long as no other file of the run has claimed that name
+	if (!found || (!claimed && own && ownLen == nameLen && !memcmp(own, name, nameLen * sizeof(char)))) {
+		g_hash_table_replace(names, g_strndup(name, nameLen), GSIZE_TO_POINTER(next << 1 | NAME_CLAIMED));
+		return nameLen;
+	}
+	if (mode == COLLISION_SKIP)
+		return 0;
+
+	char buf[FILENAME_MAX];
+	for (size_t num = MAX(next, 2), blen;; ++num) {
+		if ((blen = numberName(buf, name, nameLen, num, mode)) == SIZE_MAX)
+			return SIZE_MAX;
+		if (!g_hash_table_contains(names, buf)) {
+			g_hash_table_replace(names, g_strndup(name, nameLen), GSIZE_TO_POINTER((num + 1) << 1 | claimed));
+			g_hash_table_insert(names, g_strndup(buf, blen), GSIZE_TO_POINTER(NAME_CLAIMED));
+			memcpy(name, buf, (blen + 1) * sizeof(char));
+			return blen;
+		}
+	}
+}
+
+// a file that has been renamed away frees its old name, unless a file of the run has claimed it, and a directory that hasn't been indexed yet will see that on its own
+void releaseName(NameIndex* idx, const char* dir, size_t dlen, const char* name) {
+	GHashTable* names = idx->last;
+	if (!names || idx->lastDirLen != dlen || memcmp(idx->lastDir, dir, dlen * sizeof(char))) {
+		char* key = g_strndup(dir, dlen);
+		names = g_hash_table_lookup(idx->dirs, key);
+		g_free(key);
+		if (!names)
+			return;
+	}
+
+	gpointer val;
+	if (g_hash_table_lookup_extended(names, name, NULL, &val) && !(GPOINTER_TO_SIZE(val) & NAME_CLAIMED))
+		g_hash_table_remove(names, name);
+}
+
+void freeNameIndex(NameIndex* idx) {
+	if (idx) {
+		g_hash_table_destroy(idx->dirs);
+		free(idx);
+	}
+}
@@ -0,0 +1,11 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include "utils.h"
+
+NameIndex* newNameIndex(void);
+size_t claimName(NameIndex* idx, const char* dir, size_t dlen, char* name, size_t nameLen, const char* own, size_t ownLen, CollisionMode mode);
+void releaseName(NameIndex* idx, const char* dir, size_t dlen, const char* name);
+void freeNameIndex(NameIndex* idx);
+
+#endif
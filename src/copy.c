@@ -0,0 +1,465 @@
+#include "copy.h"
+#include "durable.h"
+#include "rename.h"
+#include "throttle.h"
+#include "verify.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/sendfile.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#define STAGE_PREFIX ".sfbrename-"
+#define STAGE_NAME_MAX (sizeof(STAGE_PREFIX) + 8)
+#define STAGE_ATTEMPTS 16
+#define COPY_BUFFER_SIZE (1024 * 1024)
+#define COPY_CHUNK_SIZE (8 * 1024 * 1024)
+
+typedef struct InodeKey {
+	dev_t dev;
+	ino_t ino;
+} InodeKey;
+#endif
+
+#ifdef _WIN32
+static int createSymlink(const char* target, const char* path) {
+	wchar_t* wpath = stow(path);
+	wchar_t* wtarget = stow(target);
+	DWORD attr = GetFileAttributesW(wtarget);
+	DWORD flags = attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) ? SYMBOLIC_LINK_FLAG_DIRECTORY : 0;
+	int rc = !CreateSymbolicLinkW(wpath, wtarget, flags);
+	free(wpath);
+	free(wtarget);
+	return rc;
+}
+#else
+static guint hashInode(const InodeKey* key) {
+	uint64_t val = (uint64_t)key->ino ^ ((uint64_t)key->dev << 32 | (uint64_t)key->dev >> 32);
+	return (guint)(val ^ val >> 32);
+}
+
+static gboolean equalInode(const InodeKey* a, const InodeKey* b) {
+	return a->ino == b->ino && a->dev == b->dev;
+}
+#endif
+
+void initCopy(Process* prc) {
+#ifndef _WIN32
+	prc->copiedInodes = g_hash_table_new_full((GHashFunc)hashInode, (GEqualFunc)equalInode, free, g_free);
+	if (prc->verify)
+		initVerify(prc);
+#endif
+}
+
+void finishCopy(Process* prc, Window* win) {
+	flushDirectories(prc, win);
+#ifndef _WIN32
+	finishVerify(prc, win);
+	if (prc->copiedInodes) {
+		g_hash_table_destroy(prc->copiedInodes);
+		prc->copiedInodes = NULL;
+	}
+#endif
+}
+
+static char* joinPath(const char* dir, size_t dlen, const char* file, size_t flen) {
+	char* path = malloc((dlen + flen + 2) * sizeof(char));
+	memcpy(path, dir, dlen * sizeof(char));
+	path[dlen] = '/';
+	memcpy(path + dlen + 1, file, (flen + 1) * sizeof(char));
+	return path;
+}
+
+#ifndef _WIN32
+static int copyXattrs(int in, int out) {
+	ssize_t nlen = flistxattr(in, NULL, 0);
+	if (nlen <= 0)
+		return nlen && errno != ENOTSUP ? -1 : 0;
+
+	char* names = malloc(nlen * sizeof(char));
+	nlen = flistxattr(in, names, nlen);
+	int rc = nlen != -1 ? 0 : -1;
+	char* value = NULL;
+	size_t vmax = 0;
+	for (const char* it = names; it < names + nlen; it += strlen(it) + 1) {
+		ssize_t vlen = fgetxattr(in, it, NULL, 0);
+		if (vlen < 0) {
+			rc = -1;
+			continue;
+		}
+		if ((size_t)vlen > vmax) {
+			vmax = vlen;
+			value = realloc(value, vmax);
+		}
+		vlen = fgetxattr(in, it, value, vlen);
+		// attributes of a namespace that requires privileges or isn't supported by the destination are skipped
+		if (vlen < 0 || (fsetxattr(out, it, value, vlen, 0) && errno != ENOTSUP && errno != EPERM))
+			rc = -1;
+	}
+	free(value);
+	free(names);
+	return rc;
+}
+
+static int copyAttributes(int in, int out, const struct stat* ps) {
+	// only a privileged user can give files away, so the copy keeps the current user's ownership otherwise
+	int rc = fchown(out, ps->st_uid, ps->st_gid) && errno != EPERM ? -1 : 0;
+	rc |= fchmod(out, ps->st_mode & ~S_IFMT);
+	rc |= copyXattrs(in, out);
+	const struct timespec times[2] = { ps->st_atim, ps->st_mtim };
+	return rc | futimens(out, times);
+}
+
+static int copyData(Process* prc, int in, int out, off_t size) {
+	// transfers are capped so that the byte count moves steadily for large files
+	for (off_t pos = 0; pos < size;) {
+		ssize_t len = sendfile(out, in, NULL, throttleChunk(prc->bytesLimit, MIN(size - pos, COPY_CHUNK_SIZE)));
+		if (len <= 0)
+			return len ? -1 : 0;
+		pos += len;
+		atomic_fetch_add_explicit(&prc->bytesDone, len, memory_order_relaxed);
+		throttle(prc->bytesLimit, len);
+	}
+	return 0;
+}
+
+static int copyHashedData(Process* prc, int in, int out, off_t size, HashState* hs) {
+	// the data has to pass through user space to be hashed, so sendfile can't be used here
+	char* buf = malloc(MIN(size, COPY_BUFFER_SIZE));
+	int rc = 0;
+	for (off_t pos = 0; pos < size;) {
+		ssize_t len = read(in, buf, throttleChunk(prc->bytesLimit, MIN(size - pos, COPY_BUFFER_SIZE)));
+		if (len <= 0) {
+			rc = len ? -1 : 0;
+			break;
+		}
+		hashUpdate(hs, buf, len);
+		for (ssize_t done = 0; done < len;) {
+			ssize_t wlen = write(out, buf + done, len - done);
+			if (wlen < 0) {
+				rc = -1;
+				break;
+			}
+			done += wlen;
+		}
+		if (rc)
+			break;
+		pos += len;
+		atomic_fetch_add_explicit(&prc->bytesDone, len, memory_order_relaxed);
+		throttle(prc->bytesLimit, len);
+	}
+	free(buf);
+	return rc;
+}
+
+// a copy never merges into an existing directory, since undoing it removes the whole tree
+static int copyDirectory(Process* prc, const char* src, const char* dst, const struct stat* ps) {
+	if (mkdir(dst, (ps->st_mode & ~S_IFMT) | S_IRWXU))
+		return -1;
+	int in = open(src, O_RDONLY | O_DIRECTORY);
+	if (in == -1)
+		return -1;
+	int out = open(dst, O_RDONLY | O_DIRECTORY);
+	if (out == -1) {
+		close(in);
+		return -1;
+	}
+
+	int rc = 0;
+	DIR* dir = opendir(src);
+	if (dir) {
+		size_t slen = strlen(src);
+		size_t dlen = strlen(dst);
+		for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir))
+			if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+				size_t nlen = strlen(entry->d_name);
+				char* from = joinPath(src, slen, entry->d_name, nlen);
+				char* to = joinPath(dst, dlen, entry->d_name, nlen);
+				rc |= copyFile(prc, from, to);
+				free(from);
+				free(to);
+			}
+		closedir(dir);
+	} else
+		rc = -1;
+
+	// the timestamps have to be set last, since filling the directory changes them
+	rc |= copyAttributes(in, out, ps);
+	close(in);
+	close(out);
+	markDirectory(prc, dst, strlen(dst));
+	markParentDirectory(prc, dst);
+	return rc;
+}
+
+static int openStaged(int dfd, mode_t mode, char* tmp) {
+	// an anonymous file can't be seen under any name until it's published, so an interruption leaves nothing behind
+	int fd = openat(dfd, ".", O_TMPFILE | O_WRONLY, mode);
+	if (fd != -1) {
+		*tmp = '\0';
+		return fd;
+	}
+	if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)
+		return -1;
+
+	for (int i = 0; i < STAGE_ATTEMPTS; ++i) {
+		snprintf(tmp, STAGE_NAME_MAX, STAGE_PREFIX "%08x", g_random_int());
+		fd = openat(dfd, tmp, O_WRONLY | O_CREAT | O_EXCL, mode);
+		if (fd != -1 || errno != EEXIST)
+			return fd;
+	}
+	return -1;
+}
+
+static int linkStaged(int fd, int dfd, const char* name) {
+	char proc[32];
+	snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+	if (!linkat(AT_FDCWD, proc, dfd, name, AT_SYMLINK_FOLLOW))
+		return 0;
+	return errno == ENOENT ? linkat(fd, "", dfd, name, AT_EMPTY_PATH) : -1;
+}
+
+static int publishStaged(int fd, int dfd, const char* name, char* tmp) {
+	if (!*tmp) {
+		if (!linkStaged(fd, dfd, name))
+			return 0;
+		if (errno != EEXIST)
+			return -1;
+
+		// an existing file is replaced atomically by giving the staged file a temporary name first
+		int rc = -1;
+		for (int i = 0; i < STAGE_ATTEMPTS && rc; ++i) {
+			snprintf(tmp, STAGE_NAME_MAX, STAGE_PREFIX "%08x", g_random_int());
+			if ((rc = linkStaged(fd, dfd, tmp)) && errno != EEXIST)
+				break;
+		}
+		if (rc) {
+			*tmp = '\0';
+			return -1;
+		}
+	}
+	return renameat(dfd, tmp, dfd, name);
+}
+
+static int copyRegular(Process* prc, const char* src, const char* dst, const struct stat* ps) {
+	InodeKey key = { ps->st_dev, ps->st_ino };
+	if (ps->st_nlink > 1 && prc->copiedInodes) {
+		const char* first = g_hash_table_lookup(prc->copiedInodes, &key);
+		if (first && !linkat(AT_FDCWD, first, AT_FDCWD, dst, 0)) {
+			markParentDirectory(prc, dst);
+			atomic_fetch_add_explicit(&prc->bytesDone, ps->st_size, memory_order_relaxed);
+			return 0;
+		}
+	}
+
+	const char* sep = strrchr(dst, '/');
+	const char* name = sep ? sep + 1 : dst;
+	size_t dlen = sep ? sep != dst ? (size_t)(sep - dst) : 1 : 0;
+	char* dirc = sep ? g_strndup(dst, dlen) : g_strdup(".");
+	int dfd = open(dirc, O_RDONLY | O_DIRECTORY);
+	int in = dfd != -1 ? open(src, O_RDONLY) : -1;
+	char tmp[STAGE_NAME_MAX] = "";
+	int out = in != -1 ? openStaged(dfd, ps->st_mode & ~S_IFMT, tmp) : -1;
+	int rc = -1;
+	HashState hs;
+	if (out != -1) {
+		if (prc->verifyPool) {
+			hashInit(&hs);
+			rc = copyHashedData(prc, in, out, ps->st_size, &hs);
+		} else
+			rc = copyData(prc, in, out, ps->st_size);
+		if (!rc)
+			rc = copyAttributes(in, out, ps);
+		if (!rc)
+			rc = fsync(out);
+		if (!rc)
+			rc = publishStaged(out, dfd, name, tmp);
+		// dropping the cached pages makes the verification read the data back from the disk
+		if (!rc && prc->verifyPool)
+			posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+	}
+
+	int err = errno;
+	if (rc && *tmp)
+		unlinkat(dfd, tmp, 0);
+	if (out != -1)
+		close(out);
+	if (in != -1)
+		close(in);
+	if (dfd != -1)
+		close(dfd);
+	if (!rc) {
+		// the directory entry only becomes durable with the directory, which gets synced once after the whole batch
+		markDirectory(prc, dirc, sep ? dlen : 1);
+		if (prc->verifyPool)
+			queueVerify(prc, dst, hashDigest(&hs));
+		if (ps->st_nlink > 1 && prc->copiedInodes) {
+			InodeKey* nkey = malloc(sizeof(InodeKey));
+			*nkey = key;
+			g_hash_table_insert(prc->copiedInodes, nkey, g_strdup(dst));
+		}
+	}
+	g_free(dirc);
+	errno = err;
+	return rc;
+}
+
+static int copySymlink(Process* prc, const char* src, const char* dst, const struct stat* ps) {
+	char* path = malloc((ps->st_size + 1) * sizeof(char));
+	ssize_t len = readlink(src, path, ps->st_size);
+	int rc = -1;
+	if (len != -1) {
+		path[len] = '\0';
+		rc = symlink(path, dst);
+	}
+	free(path);
+	if (rc)
+		return rc;
+	markParentDirectory(prc, dst);
+
+	// symlinks can't be opened, so their attributes are set by path without following them
+	rc = lchown(dst, ps->st_uid, ps->st_gid) && errno != EPERM ? -1 : 0;
+	const struct timespec times[2] = { ps->st_atim, ps->st_mtim };
+	return rc | utimensat(AT_FDCWD, dst, times, AT_SYMLINK_NOFOLLOW);
+}
+#endif
+
+int copyFile(Process* prc, const char* src, const char* dst) {
+	struct stat ps;
+#ifdef _WIN32
+	if (stat(src, &ps))
+		return -1;
+
+	int rc;
+	switch (ps.st_mode & S_IFMT) {
+	case S_IFDIR: {
+		if (mkdir(dst))
+			return -1;
+		DIR* dir = opendir(src);
+		if (!dir)
+			return -1;
+
+		rc = 0;
+		size_t slen = strlen(src);
+		size_t dlen = strlen(dst);
+		for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir))
+			if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+				size_t nlen = strlen(entry->d_name);
+				char* from = joinPath(src, slen, entry->d_name, nlen);
+				char* to = joinPath(dst, dlen, entry->d_name, nlen);
+				rc |= copyFile(prc, from, to);
+				free(from);
+				free(to);
+			}
+		closedir(dir);
+		break; }
+	case S_IFREG: {
+		wchar_t* wsrc = stow(src);
+		wchar_t* wdst = stow(dst);
+		rc = !CopyFileW(wsrc, wdst, false);
+		if (!rc) {
+			atomic_fetch_add_explicit(&prc->bytesDone, ps.st_size, memory_order_relaxed);
+			throttle(prc->bytesLimit, ps.st_size);
+		}
+		free(wsrc);
+		free(wdst);
+		break; }
+	default:
+		rc = createSymlink(src, dst);
+	}
+	return rc;
+#else
+	if (lstat(src, &ps))
+		return -1;
+
+	switch (ps.st_mode & S_IFMT) {
+	case S_IFDIR:
+		return copyDirectory(prc, src, dst, &ps);
+	case S_IFREG:
+		return copyRegular(prc, src, dst, &ps);
+	case S_IFLNK:
+		return copySymlink(prc, src, dst, &ps);
+	}
+	return symlink(src, dst);
+#endif
+}
+
+int linkFile(Process* prc, const char* src, const char* dst) {
+#ifdef _WIN32
+	wchar_t* wsrc = stow(src);
+	wchar_t* wdst = stow(dst);
+	int rc = !CreateHardLinkW(wdst, wsrc, NULL);
+	bool cross = rc && GetLastError() == ERROR_NOT_SAME_DEVICE;
+	free(wsrc);
+	free(wdst);
+	return cross ? copyFile(prc, src, dst) : rc;
+#else
+	if (!linkat(AT_FDCWD, src, AT_FDCWD, dst, 0))
+		return 0;
+	return errno == EXDEV ? copyFile(prc, src, dst) : -1;
+#endif
+}
+
+int symlinkFile(Process* prc, const char* src, const char* dst) {
+#ifdef _WIN32
+	return createSymlink(src, dst);
+#else
+	return symlink(src, dst);
+#endif
+}
+
+static int removeTree(const char* path) {
+#ifdef _WIN32
+	wchar_t* wpath = stow(path);
+	DWORD attr = GetFileAttributesW(wpath);
+	free(wpath);
+	if (attr == INVALID_FILE_ATTRIBUTES)
+		return -1;
+	// a symlink to a directory is removed like a directory, but its target must not be descended into
+	if (!(attr & FILE_ATTRIBUTE_DIRECTORY))
+		return remove(path);
+	if (attr & FILE_ATTRIBUTE_REPARSE_POINT)
+		return rmdir(path);
+#else
+	struct stat ps;
+	if (lstat(path, &ps))
+		return -1;
+	if (!S_ISDIR(ps.st_mode))
+		return unlink(path);
+#endif
+
+	DIR* dir = opendir(path);
+	if (!dir)
+		return -1;
+	int rc = 0;
+	size_t plen = strlen(path);
+	for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir))
+		if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+			char* sub = joinPath(path, plen, entry->d_name, strlen(entry->d_name));
+			rc |= removeTree(sub);
+			free(sub);
+		}
+	closedir(dir);
+	return rc | rmdir(path);
+}
+
+int removeCopy(Process* prc, const char* path, const char* original) {
+	// a copy is only dropped while the file it was made from still exists, so undoing can't lose any data
+	struct stat ps;
+	if (stat(original, &ps))
+		return -1;
+	return removeTree(path);
+}
+
+int removeLink(Process* prc, const char* path, const char* original) {
+#ifdef _WIN32
+	return remove(path) && rmdir(path) ? -1 : 0;
+#else
+	return unlink(path);
+#endif
+}
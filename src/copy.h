@@ -0,0 +1,14 @@
+#ifndef COPY_H
+#define COPY_H
+
+#include "utils.h"
+
+void initCopy(Process* prc);
+void finishCopy(Process* prc, Window* win);
+int copyFile(Process* prc, const char* src, const char* dst);
+int linkFile(Process* prc, const char* src, const char* dst);
+int symlinkFile(Process* prc, const char* src, const char* dst);
+int removeCopy(Process* prc, const char* path, const char* original);
+int removeLink(Process* prc, const char* path, const char* original);
+
+#endif
@@ -0,0 +1,101 @@
+#include "durable.h"
+#include "rename.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+void markDirectory(Process* prc, const char* dirc, size_t dlen) {
+#ifndef _WIN32
+	// consecutive files usually share a directory, which spares a lookup for most of them
+	if (prc->lastDirty && prc->lastDirtyLen == dlen && !memcmp(prc->lastDirty, dirc, dlen * sizeof(char)))
+		return;
+	if (!prc->dirtyDirs)
+		prc->dirtyDirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	char* key = g_strndup(dirc, dlen);
+	const char* old;
+	if (g_hash_table_lookup_extended(prc->dirtyDirs, key, (gpointer*)&old, NULL)) {
+		g_free(key);
+		key = (char*)old;
+	} else
+		g_hash_table_add(prc->dirtyDirs, key);
+	prc->lastDirty = key;
+	prc->lastDirtyLen = dlen;
+#endif
+}
+
+void markParentDirectory(Process* prc, const char* path) {
+	const char* sep = strrchr(path, '/');
+	if (sep)
+		markDirectory(prc, path, sep != path ? (size_t)(sep - path) : 1);
+	else
+		markDirectory(prc, ".", 1);
+}
+
+void markApplied(Process* prc, const char* src, const char* dst, Window* win) {
+	markParentDirectory(prc, dst);
+	if (prc->destinationMode == DESTINATION_MOVE)
+		markParentDirectory(prc, src);
+	if (prc->syncEvery && ++prc->unsynced >= prc->syncEvery)
+		flushDirectories(prc, win);
+}
+
+#ifndef _WIN32
+static void syncFilesystems(Process* prc, Window* win) {
+	size_t ndevs = 0;
+	dev_t devs[16];
+	GHashTableIter it;
+	const char* dirc;
+	g_hash_table_iter_init(&it, prc->dirtyDirs);
+	while (g_hash_table_iter_next(&it, (gpointer*)&dirc, NULL)) {
+		struct stat ps;
+		if (stat(dirc, &ps))
+			continue;
+
+		size_t i = 0;
+		for (; i < ndevs && devs[i] != ps.st_dev; ++i);
+		if (i < ndevs)
+			continue;
+		if (ndevs == sizeof(devs) / sizeof(*devs)) {
+			sync();
+			return;
+		}
+		devs[ndevs++] = ps.st_dev;
+
+		int fd = open(dirc, O_RDONLY | O_DIRECTORY);
+		if (fd == -1 || syncfs(fd))
+			showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to sync filesystem of '%s': %s", dirc, strerror(errno));
+		if (fd != -1)
+			close(fd);
+	}
+}
+#endif
+
+void flushDirectories(Process* prc, Window* win) {
+#ifndef _WIN32
+	prc->unsynced = 0;
+	if (!prc->dirtyDirs)
+		return;
+
+	if (prc->syncfs)
+		syncFilesystems(prc, win);
+	else {
+		GHashTableIter it;
+		const char* dirc;
+		g_hash_table_iter_init(&it, prc->dirtyDirs);
+		while (g_hash_table_iter_next(&it, (gpointer*)&dirc, NULL)) {
+			int fd = open(dirc, O_RDONLY | O_DIRECTORY);
+			if (fd == -1 || fsync(fd))
+				showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to sync directory '%s': %s", dirc, strerror(errno));
+			if (fd != -1)
+				close(fd);
+		}
+	}
+	g_hash_table_destroy(prc->dirtyDirs);
+	prc->dirtyDirs = NULL;
+	prc->lastDirty = NULL;
+#endif
+}
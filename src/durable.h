@@ -0,0 +1,11 @@
+#ifndef DURABLE_H
+#define DURABLE_H
+
+#include "utils.h"
+
+void markDirectory(Process* prc, const char* dirc, size_t dlen);
+void markParentDirectory(Process* prc, const char* path);
+void markApplied(Process* prc, const char* src, const char* dst, Window* win);
+void flushDirectories(Process* prc, Window* win);
+
+#endif
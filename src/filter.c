@@ -0,0 +1,189 @@
+#include "filter.h"
+
+#define MATCH_ANY 1
+#define MATCH_DIR 2
+
+typedef struct Glob {
+	char* pattern;
+	bool dirOnly;
+} Glob;
+
+typedef struct PatternSet {
+	GHashTable* exts;
+	GHashTable* names;
+	Glob* globs;
+	size_t nGlobs;
+	bool used;
+} PatternSet;
+
+struct Filter {
+	PatternSet include;
+	PatternSet exclude;
+	bool typed;
+};
+
+static bool isGlob(const char* str) {
+	return strpbrk(str, "*?[\\");
+}
+
+static void addPattern(GHashTable* tbl, const char* key, int flags) {
+	flags |= GPOINTER_TO_INT(g_hash_table_lookup(tbl, key));
+	g_hash_table_insert(tbl, g_strdup(key), GINT_TO_POINTER(flags));
+}
+
+// plain names and extensions are looked up in hash tables, so that only real globs need to be matched one by one
+static bool compilePatterns(PatternSet* set, char** patterns) {
+	set->exts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	set->names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	set->globs = NULL;
+	set->nGlobs = 0;
+	set->used = patterns && *patterns;
+	if (!set->used)
+		return false;
+
+	bool typed = false;
+	size_t cnt = g_strv_length(patterns);
+	set->globs = malloc(cnt * sizeof(Glob));
+	for (size_t i = 0; i < cnt; ++i) {
+		size_t len = strlen(patterns[i]);
+		bool dirOnly = len && patterns[i][len - 1] == '/';
+		for (; len && patterns[i][len - 1] == '/'; --len);
+		if (!len)
+			continue;
+
+		char* pat = g_strndup(patterns[i], len);
+		int flags = dirOnly ? MATCH_DIR : MATCH_ANY;
+		typed |= dirOnly;
+		if (!isGlob(pat)) {
+			addPattern(set->names, pat, flags);
+			g_free(pat);
+		} else if (pat[0] == '*' && pat[1] == '.' && !isGlob(pat + 2)) {
+			addPattern(set->exts, pat + 2, flags);
+			g_free(pat);
+		} else
+			set->globs[set->nGlobs++] = (Glob){ pat, dirOnly };
+	}
+	return typed;
+}
+
+Filter* newFilter(char** include, char** exclude) {
+	if (!(include && *include) && !(exclude && *exclude))
+		return NULL;
+
+	Filter* flt = malloc(sizeof(Filter));
+	flt->typed = compilePatterns(&flt->include, include);
+	flt->typed |= compilePatterns(&flt->exclude, exclude);
+	return flt;
+}
+
+static const char* matchClass(const char* pat, char ch, bool* hit) {
+	bool neg = *pat == '!' || *pat == '^';
+	const char* beg = pat += neg;
+	*hit = false;
+	// a ']' right after the opening bracket is part of the set
+	for (; *pat && (*pat != ']' || pat == beg); ++pat) {
+		if (pat[1] == '-' && pat[2] && pat[2] != ']') {
+			*hit |= (uchar)ch >= (uchar)pat[0] && (uchar)ch <= (uchar)pat[2];
+			pat += 2;
+		} else
+			*hit |= ch == *pat;
+	}
+	if (!*pat)
+		return NULL;
+	*hit ^= neg;
+	return pat + 1;
+}
+
+static const char* matchChar(const char* pat, char ch, bool* hit) {
+	switch (*pat) {
+	case '\0':
+		*hit = false;
+		return pat;
+	case '?':
+		*hit = true;
+		return pat + 1;
+	case '[': {
+		const char* end = matchClass(pat + 1, ch, hit);
+		if (end)
+			return end;
+		break;
+	}
+	case '\\':
+		if (pat[1])
+			++pat;
+	}
+	*hit = ch == *pat;
+	return pat + 1;
+}
+
+// only the last '*' needs to be revisited on a mismatch, so a name is matched without recursion
+static bool matchGlob(const char* pat, const char* name) {
+	const char* star = NULL;
+	const char* mark = NULL;
+	while (*name) {
+		if (*pat == '*') {
+			star = ++pat;
+			mark = name;
+			continue;
+		}
+
+		bool hit;
+		const char* next = matchChar(pat, *name, &hit);
+		if (hit) {
+			pat = next;
+			++name;
+		} else if (star) {
+			pat = star;
+			name = ++mark;
+		} else
+			return false;
+	}
+	for (; *pat == '*'; ++pat);
+	return !*pat;
+}
+
+static bool matchFlags(GHashTable* tbl, const char* key, bool isDir) {
+	int flags = GPOINTER_TO_INT(g_hash_table_lookup(tbl, key));
+	return (flags & MATCH_ANY) || (isDir && (flags & MATCH_DIR));
+}
+
+static bool matchSet(const PatternSet* set, const char* name, bool isDir) {
+	if (matchFlags(set->names, name, isDir))
+		return true;
+	if (g_hash_table_size(set->exts))
+		for (const char* dot = strchr(name, '.'); dot; dot = strchr(dot + 1, '.'))
+			if (matchFlags(set->exts, dot + 1, isDir))
+				return true;
+	for (size_t i = 0; i < set->nGlobs; ++i)
+		if ((isDir || !set->globs[i].dirOnly) && matchGlob(set->globs[i].pattern, name))
+			return true;
+	return false;
+}
+
+bool filterName(const Filter* flt, const char* name, bool isDir) {
+	return !flt || ((!flt->include.used || matchSet(&flt->include, name, isDir)) && !matchSet(&flt->exclude, name, isDir));
+}
+
+bool filterPrune(const Filter* flt, const char* name) {
+	return flt && matchSet(&flt->exclude, name, true);
+}
+
+bool filterTyped(const Filter* flt) {
+	return flt && flt->typed;
+}
+
+static void freePatterns(PatternSet* set) {
+	for (size_t i = 0; i < set->nGlobs; ++i)
+		g_free(set->globs[i].pattern);
+	free(set->globs);
+	g_hash_table_destroy(set->names);
+	g_hash_table_destroy(set->exts);
+}
+
+void freeFilter(Filter* flt) {
+	if (flt) {
+		freePatterns(&flt->include);
+		freePatterns(&flt->exclude);
+		free(flt);
+	}
+}
@@ -0,0 +1,12 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "utils.h"
+
+Filter* newFilter(char** include, char** exclude);
+bool filterName(const Filter* flt, const char* name, bool isDir);
+bool filterPrune(const Filter* flt, const char* name);
+bool filterTyped(const Filter* flt);
+void freeFilter(Filter* flt);
+
+#endif
@@ -0,0 +1,103 @@
+#include "hash.h"
+#include <glib.h>
+#include <string.h>
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+	return x << r | x >> (64 - r);
+}
+
+static inline uint64_t read64(const uint8_t* p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return GUINT64_FROM_LE(v);
+}
+
+static inline uint32_t read32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return GUINT32_FROM_LE(v);
+}
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t val) {
+	return rotl64(acc + val * PRIME2, 31) * PRIME1;
+}
+
+static inline uint64_t hashMerge(uint64_t acc, uint64_t val) {
+	return (acc ^ hashRound(0, val)) * PRIME1 + PRIME4;
+}
+
+static const uint8_t* hashStripes(uint64_t* acc, const uint8_t* p, const uint8_t* end) {
+	for (; p + 32 <= end; p += 32) {
+		acc[0] = hashRound(acc[0], read64(p));
+		acc[1] = hashRound(acc[1], read64(p + 8));
+		acc[2] = hashRound(acc[2], read64(p + 16));
+		acc[3] = hashRound(acc[3], read64(p + 24));
+	}
+	return p;
+}
+
+// streaming XXH64 with a seed of 0, so digests can be compared against other xxhsum tools
+void hashInit(HashState* hs) {
+	hs->acc[0] = PRIME1 + PRIME2;
+	hs->acc[1] = PRIME2;
+	hs->acc[2] = 0;
+	hs->acc[3] = -PRIME1;
+	hs->total = 0;
+	hs->bufLen = 0;
+}
+
+void hashUpdate(HashState* hs, const void* data, size_t len) {
+	const uint8_t* p = data;
+	const uint8_t* end = p + len;
+	hs->total += len;
+	if (hs->bufLen + len < 32) {
+		memcpy(hs->buf + hs->bufLen, p, len);
+		hs->bufLen += len;
+		return;
+	}
+
+	if (hs->bufLen) {
+		size_t fill = 32 - hs->bufLen;
+		memcpy(hs->buf + hs->bufLen, p, fill);
+		hashStripes(hs->acc, hs->buf, hs->buf + 32);
+		p += fill;
+		hs->bufLen = 0;
+	}
+	p = hashStripes(hs->acc, p, end);
+	hs->bufLen = end - p;
+	memcpy(hs->buf, p, hs->bufLen);
+}
+
+uint64_t hashDigest(const HashState* hs) {
+	uint64_t h;
+	if (hs->total >= 32) {
+		h = rotl64(hs->acc[0], 1) + rotl64(hs->acc[1], 7) + rotl64(hs->acc[2], 12) + rotl64(hs->acc[3], 18);
+		for (int i = 0; i < 4; ++i)
+			h = hashMerge(h, hs->acc[i]);
+	} else
+		h = hs->acc[2] + PRIME5;
+	h += hs->total;
+
+	const uint8_t* p = hs->buf;
+	const uint8_t* end = p + hs->bufLen;
+	for (; p + 8 <= end; p += 8)
+		h = rotl64(h ^ hashRound(0, read64(p)), 27) * PRIME1 + PRIME4;
+	if (p + 4 <= end) {
+		h = rotl64(h ^ read32(p) * PRIME1, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; ++p)
+		h = rotl64(h ^ *p * PRIME5, 11) * PRIME1;
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	return h ^ h >> 32;
+}
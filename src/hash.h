@@ -0,0 +1,18 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct HashState {
+	uint64_t acc[4];
+	uint64_t total;
+	uint8_t buf[32];
+	uint8_t bufLen;
+} HashState;
+
+void hashInit(HashState* hs);
+void hashUpdate(HashState* hs, const void* data, size_t len);
+uint64_t hashDigest(const HashState* hs);
+
+#endif
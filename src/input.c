@@ -0,0 +1,251 @@
+#include "input.h"
+#include "arguments.h"
+#include "filter.h"
+#include "walker.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#define INPUT_BUFFER_SIZE (PATH_MAX * 64)
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+static bool filterSource(const Input* in, char* path, size_t* plen) {
+	for (; *plen > 1 && path[*plen - 1] == '/'; path[--*plen] = '\0');
+	const char* sep = memrchr(path, '/', *plen * sizeof(char));
+	struct stat ps;
+	bool isDir = filterTyped(in->filter) && !stat(path, &ps) && S_ISDIR(ps.st_mode);
+	return filterName(in->filter, sep && sep[1] ? sep + 1 : path, isDir);
+}
+
+bool openInput(Input* in, const Arguments* arg, char** paths, size_t nPaths, Window* win) {
+	memset(in, 0, sizeof(Input));
+	in->fd = -1;
+#ifndef _WIN32
+	in->wake[0] = in->wake[1] = -1;
+#endif
+	in->win = win;
+	in->filter = newFilter(arg->include, arg->exclude);
+	if (arg->recursive) {
+		in->walker = newWalker(arg, in->filter);
+		in->path = malloc(PATH_MAX * sizeof(char));
+	}
+	if (!arg->filesFrom) {
+		in->paths = paths;
+		// the arguments are checked and filtered in advance, so that they can still be processed backwards
+		for (size_t i = 0; i < nPaths; ++i) {
+			size_t plen = strlen(paths[i]);
+			if (plen >= PATH_MAX) {
+				showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Path '%.32s...' is too long", paths[i]);
+				continue;
+			}
+#ifdef _WIN32
+			unbackslashify(paths[i]);
+#endif
+			if (!in->filter || in->walker || filterSource(in, paths[i], &plen))
+				paths[in->nPaths++] = paths[i];
+		}
+		return in->nPaths;
+	}
+
+	if (strcmp(arg->filesFrom, "-"))
+		in->fd = open(arg->filesFrom, O_RDONLY | O_BINARY);
+	else
+		in->fd = fileno(stdin);
+	if (in->fd == -1) {
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to open file list '%s': %s", arg->filesFrom, strerror(errno));
+		return false;
+	}
+#ifndef _WIN32
+	// a reader on another thread can be woken through this pipe when it's waiting for a slow producer
+	if (pipe(in->wake))
+		in->wake[0] = in->wake[1] = -1;
+#endif
+	// one spare byte for terminating a last record that has no delimiter
+	in->buf = malloc((INPUT_BUFFER_SIZE + 1) * sizeof(char));
+	in->workDir = workingDirectory();
+	in->resolved = malloc((PATH_MAX + strlen(in->workDir) + 2) * sizeof(char));
+	in->delim = arg->nullData ? '\0' : '\n';
+	// the metadata only describes the listed paths and not what's found inside them
+	in->hasMeta = arg->inputMeta && !arg->recursive;
+	return true;
+}
+
+static char* readInput(Input* in, size_t* plen) {
+	for (;;) {
+		char* rec = in->buf + in->pos;
+		char* sep = memchr(rec, in->delim, (in->end - in->pos) * sizeof(char));
+		if (sep || (in->eof && in->pos < in->end)) {
+			if (!sep)
+				sep = in->buf + in->end;
+			*sep = '\0';
+			*plen = sep - rec;
+			in->pos = MIN((size_t)(sep - in->buf + 1), in->end);
+			if (in->delim == '\n' && *plen && rec[*plen - 1] == '\r')
+				rec[--*plen] = '\0';
+			if (*plen)
+				return rec;
+			continue;
+		}
+		if (in->eof)
+			return NULL;
+
+		size_t left = in->end - in->pos;
+		if (left == INPUT_BUFFER_SIZE) {
+			showMessage(in->win, MESSAGE_ERROR, BUTTONS_OK, "File list contains an entry that is longer than %d bytes", INPUT_BUFFER_SIZE);
+			return NULL;
+		}
+		memmove(in->buf, rec, left * sizeof(char));
+		in->pos = 0;
+		in->end = left;
+
+#ifndef _WIN32
+		if (in->wake[0] != -1) {
+			struct pollfd fds[2] = { { in->fd, POLLIN, 0 }, { in->wake[0], POLLIN, 0 } };
+			if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+				showMessage(in->win, MESSAGE_ERROR, BUTTONS_OK, "Failed to read file list: %s", strerror(errno));
+				return NULL;
+			}
+			if (fds[1].revents)
+				return NULL;
+			if (!fds[0].revents)
+				continue;
+		}
+#endif
+		ssize_t rlen = read(in->fd, in->buf + left, (INPUT_BUFFER_SIZE - left) * sizeof(char));
+		if (rlen < 0) {
+			if (errno == EINTR)
+				continue;
+			showMessage(in->win, MESSAGE_ERROR, BUTTONS_OK, "Failed to read file list: %s", strerror(errno));
+			return NULL;
+		}
+		if (!rlen)
+			in->eof = true;
+		in->end += rlen;
+	}
+}
+
+static bool parseNumber(char** pos, uint64_t* val) {
+	char* end;
+	*val = strtoull(*pos, &end, 10);
+	if (end == *pos || *end != '\t')
+		return false;
+	*pos = end + 1;
+	return true;
+}
+
+static bool parseTime(char** pos, int64_t* val) {
+	char* end;
+	*val = strtoll(*pos, &end, 10);
+	if (*end == '.')
+		end += 1 + strspn(end + 1, "0123456789");
+	if (end == *pos || *end != '\t')
+		return false;
+	*pos = end + 1;
+	return true;
+}
+
+// the columns are in the order of find -printf '%s\t%T@\t%C@\t%U\t%i\t%p\n', so paths may contain tabs, but the inode isn't needed
+static char* parseMeta(FileMeta* meta, char* rec) {
+	uint64_t uid, ino;
+	if (!parseNumber(&rec, &meta->size) || !parseTime(&rec, &meta->mtime) || !parseTime(&rec, &meta->ctime) || !parseNumber(&rec, &uid) || !parseNumber(&rec, &ino))
+		return NULL;
+	meta->uid = (uint32_t)uid;
+	return rec;
+}
+
+// a path stays valid until the next call, and it's resolved like the arguments, so that records hold the same form either way
+static char* readList(Input* in, size_t* plen) {
+	char* rec;
+	while ((rec = readInput(in, plen))) {
+		char* path = rec;
+		if (in->hasMeta && !(path = parseMeta(&in->meta, rec)))
+			showMessage(in->win, MESSAGE_ERROR, BUTTONS_OK, "Invalid metadata in file list entry '%.64s'", rec);
+		else if ((*plen -= path - rec) >= PATH_MAX)
+			showMessage(in->win, MESSAGE_ERROR, BUTTONS_OK, "Path '%.32s...' is too long", path);
+		else if (*plen) {
+			*plen = resolvePath(in->resolved, in->workDir, path) - in->resolved;
+			if (*plen < PATH_MAX)
+				return in->resolved;
+			showMessage(in->win, MESSAGE_ERROR, BUTTONS_OK, "Path '%.32s...' is too long", in->resolved);
+		}
+	}
+	return NULL;
+}
+
+static const char* nextSource(Input* in, size_t id, size_t* plen) {
+	char* path;
+	do {
+		if (in->buf) {
+			if (!(path = readList(in, plen)))
+				return NULL;
+		} else {
+			if (id >= in->nPaths)
+				return NULL;
+			path = in->paths[id];
+			*plen = strlen(path);
+		}
+#ifdef _WIN32
+		unbackslashify(path);
+#endif
+	} while (in->buf && in->filter && !in->walker && !filterSource(in, path, plen));
+	return path;
+}
+
+const char* nextInput(Input* in, size_t id, size_t* plen) {
+	if (!in->walker)
+		return nextSource(in, id, plen);
+
+	// the ID counts the walked entries, so the sources need their own position
+	for (;;) {
+		if (nextWalk(in->walker, in->path, plen, in->win))
+			return in->path;
+
+		const char* root = nextSource(in, in->root++, plen);
+		if (!root)
+			return NULL;
+		if (startWalk(in->walker, root, *plen, in->win) == WALK_EMIT)
+			return root;
+	}
+}
+
+// a list read from a console on Windows can't be interrupted, so there the reader still waits for the next line
+void cancelInput(Input* in) {
+#ifndef _WIN32
+	if (in->wake[1] != -1)
+		(void)!write(in->wake[1], "", 1);
+#endif
+}
+
+void closeInput(Input* in) {
+	if (in->walker) {
+		freeWalker(in->walker);
+		free(in->path);
+		in->walker = NULL;
+	}
+	if (in->buf) {
+		if (in->fd != fileno(stdin))
+			close(in->fd);
+		free(in->buf);
+		free(in->resolved);
+		g_free(in->workDir);
+		in->buf = NULL;
+	}
+#ifndef _WIN32
+	if (in->wake[0] != -1) {
+		close(in->wake[0]);
+		close(in->wake[1]);
+		in->wake[0] = in->wake[1] = -1;
+	}
+#endif
+	freeFilter(in->filter);
+	in->filter = NULL;
+}
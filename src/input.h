@@ -0,0 +1,36 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "utils.h"
+
+#define inputStreamed(in) ((in)->buf || (in)->walker)
+
+typedef struct Input {
+	char** paths;
+	size_t nPaths;
+	char* buf;
+	char* path;
+	char* workDir;
+	char* resolved;
+	Filter* filter;
+	Walker* walker;
+	size_t root;
+	size_t pos;
+	size_t end;
+	int fd;
+#ifndef _WIN32
+	int wake[2];
+#endif
+	Window* win;
+	FileMeta meta;
+	char delim;
+	bool eof;
+	bool hasMeta;
+} Input;
+
+bool openInput(Input* in, const Arguments* arg, char** paths, size_t nPaths, Window* win);
+const char* nextInput(Input* in, size_t id, size_t* plen);
+void cancelInput(Input* in);
+void closeInput(Input* in);
+
+#endif
@@ -0,0 +1,156 @@
+#include "journal.h"
+#include "rename.h"
+#include <errno.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define JOURNAL_MAGIC 0x4A424653
+#define JOURNAL_VERSION 1
+#define JOURNAL_BUFFER_SIZE (256 * 1024)
+
+typedef struct JournalHeader {
+	uint32_t magic;
+	uint32_t version;
+} JournalHeader;
+
+bool openJournal(Process* prc, const char* path, Window* win) {
+	prc->journal = fopen(path, "ab");
+	if (!prc->journal) {
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to open journal '%s': %s", path, strerror(errno));
+		return false;
+	}
+	// records are only handed to the system once the buffer is full, which keeps the cost per rename at a memcpy
+	setvbuf(prc->journal, NULL, _IOFBF, JOURNAL_BUFFER_SIZE);
+	prc->workDir = workingDirectory();
+	fseek(prc->journal, 0, SEEK_END);
+	if (!ftell(prc->journal)) {
+		JournalHeader head = { JOURNAL_MAGIC, JOURNAL_VERSION };
+		fwrite(&head, sizeof(head), 1, prc->journal);
+	}
+	return true;
+}
+
+void writeRecordString(FILE* fd, const char* str) {
+	uint16_t len = strlen(str);
+	fwrite(&len, sizeof(len), 1, fd);
+	fwrite(str, sizeof(char), len + 1, fd);
+}
+
+// relative paths are stored with the working directory in front, so that an undo works from anywhere
+static void writeRecordPath(FILE* fd, const char* dir, const char* path) {
+	if (!dir || g_path_is_absolute(path)) {
+		writeRecordString(fd, path);
+		return;
+	}
+	for (; path[0] == '.' && path[1] == '/'; path += 2);
+	size_t dlen = strlen(dir), plen = strlen(path);
+	uint16_t len = dlen + 1 + plen;
+	fwrite(&len, sizeof(len), 1, fd);
+	fwrite(dir, sizeof(char), dlen, fd);
+	fputc('/', fd);
+	fwrite(path, sizeof(char), plen + 1, fd);
+}
+
+void writeJournal(Process* prc, const char* src, const char* dst) {
+	uint8_t mode = prc->destinationMode;
+	fwrite(&mode, sizeof(mode), 1, prc->journal);
+	writeRecordPath(prc->journal, prc->workDir, src);
+	writeRecordPath(prc->journal, prc->workDir, dst);
+}
+
+void closeJournal(Process* prc, Window* win) {
+	if (!prc->journal)
+		return;
+
+	bool ok = !fflush(prc->journal) && !ferror(prc->journal);
+#ifndef _WIN32
+	ok = ok && !fsync(fileno(prc->journal));
+#endif
+	if (!ok)
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to write journal: %s", strerror(errno));
+	fclose(prc->journal);
+	prc->journal = NULL;
+	g_free(prc->workDir);
+	prc->workDir = NULL;
+}
+
+const char* readRecordString(const char** pos, const char* end) {
+	uint16_t len;
+	if (end - *pos < (ptrdiff_t)sizeof(len))
+		return NULL;
+	memcpy(&len, *pos, sizeof(len));
+	const char* str = *pos + sizeof(len);
+	if (end - str <= len || str[len])
+		return NULL;
+	*pos = str + len + 1;
+	return str;
+}
+
+JournalEntry* loadJournal(const char* path, GMappedFile** map, size_t* count, Window* win) {
+	GError* err = NULL;
+	*map = g_mapped_file_new(path, false, &err);
+	if (!*map) {
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to open journal '%s': %s", path, err->message);
+		g_clear_error(&err);
+		return NULL;
+	}
+
+	const char* pos = g_mapped_file_get_contents(*map);
+	const char* end = pos + g_mapped_file_get_length(*map);
+	JournalHeader head = { 0, 0 };
+	if (end - pos >= (ptrdiff_t)sizeof(head))
+		memcpy(&head, pos, sizeof(head));
+	if (head.magic != JOURNAL_MAGIC || head.version > JOURNAL_VERSION) {
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "'%s' is not a valid journal", path);
+		g_mapped_file_unref(*map);
+		*map = NULL;
+		return NULL;
+	}
+	pos += sizeof(head);
+
+	size_t lim = 64;
+	JournalEntry* entries = malloc(lim * sizeof(JournalEntry));
+	*count = 0;
+	// an interrupted run can leave a partial record at the end, which is dropped along with anything after it
+	while (pos < end && (uint8_t)*pos <= DESTINATION_HARDLINK) {
+		const char* next = pos + 1;
+		const char* src = readRecordString(&next, end);
+		const char* dst = src ? readRecordString(&next, end) : NULL;
+		if (!dst)
+			break;
+
+		if (*count == lim) {
+			lim *= 2;
+			entries = realloc(entries, lim * sizeof(JournalEntry));
+		}
+		entries[(*count)++] = (JournalEntry){ .src = src, .dst = dst, .mode = (uint8_t)*pos };
+		pos = next;
+	}
+	return entries;
+}
+
+bool mergeJournals(Process* prc, const char* path, char** paths, size_t nPaths) {
+	if (!openJournal(prc, path, NULL))
+		return false;
+
+	bool ok = true;
+	for (size_t i = 0; i < nPaths; ++i) {
+		GMappedFile* map;
+		size_t count;
+		JournalEntry* entries = loadJournal(paths[i], &map, &count, NULL);
+		if (!entries) {
+			ok = false;
+			continue;
+		}
+
+		for (size_t j = 0; j < count; ++j) {
+			prc->destinationMode = entries[j].mode;
+			writeJournal(prc, entries[j].src, entries[j].dst);
+		}
+		free(entries);
+		g_mapped_file_unref(map);
+	}
+	closeJournal(prc, NULL);
+	return ok;
+}
@@ -0,0 +1,20 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "utils.h"
+
+typedef struct JournalEntry {
+	const char* src;
+	const char* dst;
+	DestinationMode mode;
+} JournalEntry;
+
+void writeRecordString(FILE* fd, const char* str);
+const char* readRecordString(const char** pos, const char* end);
+bool openJournal(Process* prc, const char* path, Window* win);
+void writeJournal(Process* prc, const char* src, const char* dst);
+void closeJournal(Process* prc, Window* win);
+JournalEntry* loadJournal(const char* path, GMappedFile** map, size_t* count, Window* win);
+bool mergeJournals(Process* prc, const char* path, char** paths, size_t nPaths);
+
+#endif
@@ -1,11 +1,11 @@
 #include "arguments.h"
+#include "journal.h"
+#include "plan.h"
 #include "rename.h"
 #include "window.h"
 
 typedef struct Program {
-#ifdef CONSOLE
-	GApplication* app;
-#else
+#ifndef CONSOLE
 	GtkApplication* app;
 	Window* win;
 #endif
@@ -13,27 +13,112 @@ typedef struct Program {
 	Process proc;
 } Program;
 
-static void runConsole(Program* prog, GFile** files, int nFiles) {
+static bool processArguments(Program* prog, GError** err) {
 	Arguments* arg = &prog->args;
-	if (arg->dry)
-		consolePreview(&prog->proc, arg, files, nFiles);
-	else
-		consoleRename(&prog->proc, arg, files, nFiles);
+	if (!processArgumentOptions(arg, err))
+		return false;
+	prog->proc.messageBehavior = arg->msgAbort ? MSGBEHAVIOR_ABORT : arg->msgContinue ? MSGBEHAVIOR_CONTINUE : MSGBEHAVIOR_ASK;
+	return true;
 }
 
-static void openApplication(GtkApplication* app, GFile** files, int nFiles, const char* hint, Program* prog) {
+static void runConsole(Program* prog, char** paths, size_t nPaths) {
 	Arguments* arg = &prog->args;
 	Process* prc = &prog->proc;
-	processArgumentOptions(arg);
-	prc->messageBehavior = arg->msgAbort ? MSGBEHAVIOR_ABORT : arg->msgContinue ? MSGBEHAVIOR_CONTINUE : MSGBEHAVIOR_ASK;
-#ifdef CONSOLE
-	runConsole(prog, files, nFiles);
-#else
-	if (arg->noGui)
-		runConsole(prog, files, nFiles);
+	if (arg->undo)
+		consoleUndo(prc, arg);
+	else if (arg->mergeJournal)
+		mergeJournals(prc, arg->mergeJournal, paths, nPaths);
+	else if (arg->planIn && arg->planShards)
+		splitPlan(arg->planIn, arg->planShards, arg->verbose);
+	else if (arg->planIn)
+		consoleApplyPlan(prc, arg);
+	else if (arg->planOut)
+		consolePlan(prc, arg, paths, nPaths);
+	else if (arg->dry)
+		consolePreview(prc, arg, paths, nPaths);
 	else
-		prog->win = openWindow(prog->app, arg, prc, files, nFiles);
+		consoleRename(prc, arg, paths, nPaths);
+}
+
+#ifndef CONSOLE
+static bool isConsoleRun(const Arguments* arg) {
+	return arg->noGui || arg->undo || arg->planIn || arg->planOut || arg->mergeJournal || arg->rules;
+}
+#endif
+
+// the parser leaves the file arguments in argv, so a run without a window takes them from there without a GFile each
+// the GUI build gets -1 when a window has to be opened instead
+static int runCommandLine(Program* prog, int argc, char** argv) {
+	GOptionContext* ctx = initCommandLineContext(&prog->args, argc, argv);
+	GError* err = NULL;
+#ifndef CONSOLE
+	// the window's own options and any mistakes are left to GApplication, which parses the arguments again
+	g_option_context_set_help_enabled(ctx, FALSE);
+	g_option_context_set_ignore_unknown_options(ctx, TRUE);
+#endif
+#ifdef _WIN32
+	char** args = g_win32_get_command_line();
+	bool ok = g_option_context_parse_strv(ctx, &args, &err);
+	argv = args;
+	argc = g_strv_length(args);
+#elif defined(CONSOLE)
+	bool ok = g_option_context_parse(ctx, &argc, &argv, &err);
+#else
+	char** args = memcpy(malloc((argc + 1) * sizeof(char*)), argv, (argc + 1) * sizeof(char*));
+	argv = args;
+	bool ok = g_option_context_parse(ctx, &argc, &argv, &err);
+#endif
+	bool window = false;
+#ifndef CONSOLE
+	window = !ok || !isConsoleRun(&prog->args);
+	if (window)
+		g_clear_error(&err);
+#endif
+	if (!window) {
+		if (ok)
+			ok = processArguments(prog, &err);
+		if (ok) {
+			// the paths are resolved like GFile would, so that the GUI build records the same paths as before
+			char** paths = resolvePaths(argv + 1, argc - 1);
+			runConsole(prog, paths, argc - 1);
+			free(paths);
+		} else {
+			g_printerr("%s\n", err->message);
+			g_clear_error(&err);
+		}
+	}
+	g_option_context_free(ctx);
+#ifdef _WIN32
+	g_strfreev(args);
+#elif !defined(CONSOLE)
+	free(args);
 #endif
+	if (window) {
+		freeArguments(&prog->args);
+		memset(&prog->args, 0, sizeof(Arguments));
+		return -1;
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#ifdef CONSOLE
+int main(int argc, char** argv) {
+	Program* prog = malloc(sizeof(Program));
+	memset(prog, 0, sizeof(Program));
+	int rc = runCommandLine(prog, argc, argv);
+	freeArguments(&prog->args);
+	free(prog);
+	return rc;
+}
+#else
+static void openApplication(GtkApplication* app, GFile** files, int nFiles, const char* hint, Program* prog) {
+	GError* err = NULL;
+	if (!processArguments(prog, &err)) {
+		g_printerr("%s\n", err->message);
+		g_clear_error(&err);
+		return;
+	}
+	prog->win = openWindow(prog->app, &prog->args, &prog->proc, files, nFiles);
 }
 
 static void activateApplication(GtkApplication* app, Program* prog) {
@@ -43,20 +128,18 @@ static void activateApplication(GtkApplication* app, Program* prog) {
 int main(int argc, char** argv) {
 	Program* prog = malloc(sizeof(Program));
 	memset(prog, 0, sizeof(Program));
-#ifdef CONSOLE
-	prog->app = g_application_new(NULL, G_APPLICATION_HANDLES_OPEN);
-#else
-	prog->app = gtk_application_new(NULL, G_APPLICATION_HANDLES_OPEN);
-#endif
-	g_signal_connect(prog->app, "activate", G_CALLBACK(activateApplication), prog);
-	g_signal_connect(prog->app, "open", G_CALLBACK(openApplication), prog);
-	initCommandLineArguments(G_APPLICATION(prog->app), &prog->args, argc, argv);
-	int rc = g_application_run(G_APPLICATION(prog->app), argc, argv);
-	g_object_unref(prog->app);
-#ifndef CONSOLE
-	freeWindow(prog->win);
-#endif
+	int rc = runCommandLine(prog, argc, argv);
+	if (rc < 0) {
+		prog->app = gtk_application_new(NULL, G_APPLICATION_HANDLES_OPEN);
+		g_signal_connect(prog->app, "activate", G_CALLBACK(activateApplication), prog);
+		g_signal_connect(prog->app, "open", G_CALLBACK(openApplication), prog);
+		initCommandLineArguments(G_APPLICATION(prog->app), &prog->args, argc, argv);
+		rc = g_application_run(G_APPLICATION(prog->app), argc, argv);
+		g_object_unref(prog->app);
+		freeWindow(prog->win);
+	}
 	freeArguments(&prog->args);
 	free(prog);
 	return rc;
 }
+#endif
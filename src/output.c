@@ -0,0 +1,160 @@
+#include "output.h"
+
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+#define OUTPUT_BUFFERS 4
+#define OUTPUT_FLUSH_INTERVAL (G_USEC_PER_SEC / 5)
+
+struct OutputBuffer {
+	size_t len;
+	char data[OUTPUT_BUFFER_SIZE];
+};
+
+// a partly filled buffer is only taken when no full ones are queued, so that the records stay in order
+static OutputBuffer* takeOutput(Output* out) {
+	// the writer holds the lock while it waits for a free buffer, so this mustn't wait for it
+	OutputBuffer* buf = NULL;
+	if (!g_mutex_trylock(&out->lock))
+		return NULL;
+	if (out->buf && out->buf->len && !g_async_queue_length(out->full)) {
+		OutputBuffer* next = g_async_queue_try_pop(out->free);
+		if (next) {
+			buf = out->buf;
+			out->buf = next;
+		}
+	}
+	g_mutex_unlock(&out->lock);
+	return buf;
+}
+
+// the records are written by a separate thread, so that a slow terminal or pipe doesn't hold up the renaming
+static void* outputProc(Output* out) {
+	bool ok = true;
+	for (OutputBuffer* buf;;) {
+		// a slow run still shows its progress, since whatever is buffered gets written out periodically
+		if (!(buf = g_async_queue_timeout_pop(out->full, OUTPUT_FLUSH_INTERVAL)) && !(buf = takeOutput(out)))
+			continue;
+		if (buf == (OutputBuffer*)out)
+			break;
+		if (ok && (fwrite(buf->data, sizeof(char), buf->len, stdout) != buf->len || fflush(stdout)))
+			ok = false;
+		buf->len = 0;
+		g_async_queue_push(out->free, buf);
+	}
+	fflush(stdout);
+	return NULL;
+}
+
+void openOutput(Output* out, OutputFormat format) {
+	out->format = format;
+	out->full = g_async_queue_new();
+	out->free = g_async_queue_new_full(free);
+	for (int i = 1; i < OUTPUT_BUFFERS; ++i) {
+		OutputBuffer* buf = malloc(sizeof(OutputBuffer));
+		buf->len = 0;
+		g_async_queue_push(out->free, buf);
+	}
+	out->buf = malloc(sizeof(OutputBuffer));
+	out->buf->len = 0;
+	g_mutex_init(&out->lock);
+	out->thread = g_thread_new("output", (GThreadFunc)outputProc, out);
+}
+
+// a full buffer has to wait for a free one, which keeps the memory use bounded when the output can't keep up
+static char* reserveOutput(Output* out, size_t len) {
+	if (out->buf->len + len > OUTPUT_BUFFER_SIZE) {
+		g_async_queue_push(out->full, out->buf);
+		out->buf = g_async_queue_pop(out->free);
+	}
+	return out->buf->data + out->buf->len;
+}
+
+static void appendOutput(Output* out, const char* str, size_t len) {
+	memcpy(reserveOutput(out, len), str, len * sizeof(char));
+	out->buf->len += len;
+}
+
+static void appendJson(Output* out, const char* str) {
+	// every byte takes at most six characters when escaped, which a path can't fill a buffer with
+	char* dst = reserveOutput(out, strlen(str) * 6 + 2);
+	char* pos = dst;
+	*pos++ = '"';
+	for (; *str; ++str) {
+		uchar ch = *str;
+		switch (ch) {
+		case '"':
+		case '\\':
+			*pos++ = '\\';
+			*pos++ = ch;
+			break;
+		case '\n':
+			*pos++ = '\\';
+			*pos++ = 'n';
+			break;
+		case '\t':
+			*pos++ = '\\';
+			*pos++ = 't';
+			break;
+		default:
+			if (ch < 0x20)
+				pos += sprintf(pos, "\\u%04x", ch);
+			else if (ch < 0x80)
+				*pos++ = ch;
+			else if ((gint32)g_utf8_get_char_validated(str, -1) < 0)
+				// bytes that aren't valid UTF-8 would make the whole line unreadable as JSON
+				pos += sprintf(pos, "\\u%04x", ch);
+			else {
+				size_t clen = g_utf8_skip[ch];
+				memcpy(pos, str, clen * sizeof(char));
+				pos += clen;
+				str += clen - 1;
+			}
+		}
+	}
+	*pos++ = '"';
+	out->buf->len += pos - dst;
+}
+
+void writeOutput(Output* out, const char* src, const char* dst) {
+	g_mutex_lock(&out->lock);
+	switch (out->format) {
+	case OUTPUT_TEXT:
+		appendOutput(out, dst ? "'" : "Removed '", dst ? 1 : 9);
+		appendOutput(out, src, strlen(src));
+		if (dst) {
+			appendOutput(out, "' -> '", 6);
+			appendOutput(out, dst, strlen(dst));
+		}
+		appendOutput(out, "'\n", 2);
+		break;
+	case OUTPUT_NUL:
+		// a removed file has an empty destination
+		appendOutput(out, src, strlen(src) + 1);
+		appendOutput(out, dst ? dst : "", dst ? strlen(dst) + 1 : 1);
+		break;
+	case OUTPUT_JSON:
+		appendOutput(out, "{\"src\":", 7);
+		appendJson(out, src);
+		appendOutput(out, ",\"dst\":", 7);
+		if (dst)
+			appendJson(out, dst);
+		else
+			appendOutput(out, "null", 4);
+		appendOutput(out, "}\n", 2);
+	}
+	g_mutex_unlock(&out->lock);
+}
+
+void closeOutput(Output* out) {
+	g_mutex_lock(&out->lock);
+	if (out->buf->len)
+		g_async_queue_push(out->full, out->buf);
+	else
+		free(out->buf);
+	out->buf = NULL;
+	g_mutex_unlock(&out->lock);
+	g_async_queue_push(out->full, out);
+	g_thread_join(out->thread);
+	g_mutex_clear(&out->lock);
+	g_async_queue_unref(out->full);
+	g_async_queue_unref(out->free);
+}
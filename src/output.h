@@ -0,0 +1,21 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "utils.h"
+
+typedef struct OutputBuffer OutputBuffer;
+
+typedef struct Output {
+	GThread* thread;
+	GAsyncQueue* full;
+	GAsyncQueue* free;
+	OutputBuffer* buf;
+	GMutex lock;
+	OutputFormat format;
+} Output;
+
+void openOutput(Output* out, OutputFormat format);
+void writeOutput(Output* out, const char* src, const char* dst);
+void closeOutput(Output* out);
+
+#endif
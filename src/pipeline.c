@@ -0,0 +1,184 @@
+#include "pipeline.h"
+#include <stdatomic.h>
+
+#define PIPE_RING_SIZE 64
+#define PIPE_SPINS 64
+
+// every worker has its own ring, whose slots are filled by the reader, named by the worker and then applied in place
+typedef struct PipeRing {
+	PipeItem* items;
+	atomic_size_t ingested;
+	atomic_size_t computed;
+	atomic_size_t applied;
+} PipeRing;
+
+typedef struct PipeWait {
+	PipeRing* ring;
+	size_t pos;
+} PipeWait;
+
+typedef bool (*PipeReady)(Pipeline* pl, const PipeWait* pw);
+
+typedef struct PipeWorker {
+	Pipeline* pl;
+	GThread* thread;
+	size_t id;
+} PipeWorker;
+
+struct Pipeline {
+	PipeRing* rings;
+	PipeWorker* workers;
+	GThread* reader;
+	PipeIngest ingest;
+	PipeCompute compute;
+	void* data;
+	PipeRing* current;
+	size_t nWorkers;
+	size_t next;
+	GMutex mutex;
+	GCond cond;
+	atomic_uint sleepers;
+	atomic_size_t total;
+	atomic_bool done;
+	atomic_bool stop;
+};
+
+// a thread spins for a short while and then sleeps until one of the others moves a counter, which it only wakes when somebody is asleep
+static void waitPipe(Pipeline* pl, PipeReady ready, PipeRing* ring, size_t pos) {
+	PipeWait pw = { ring, pos };
+	for (uint spins = 0; spins < PIPE_SPINS; ++spins) {
+		if (ready(pl, &pw))
+			return;
+		g_thread_yield();
+	}
+
+	atomic_fetch_add_explicit(&pl->sleepers, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	g_mutex_lock(&pl->mutex);
+	while (!ready(pl, &pw))
+		g_cond_wait(&pl->cond, &pl->mutex);
+	g_mutex_unlock(&pl->mutex);
+	atomic_fetch_sub_explicit(&pl->sleepers, 1, memory_order_relaxed);
+}
+
+static void wakePipe(Pipeline* pl) {
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&pl->sleepers, memory_order_relaxed)) {
+		g_mutex_lock(&pl->mutex);
+		g_cond_broadcast(&pl->cond);
+		g_mutex_unlock(&pl->mutex);
+	}
+}
+
+static bool readReady(Pipeline* pl, const PipeWait* pw) {
+	return pw->pos - atomic_load_explicit(&pw->ring->applied, memory_order_acquire) < PIPE_RING_SIZE || atomic_load_explicit(&pl->stop, memory_order_relaxed);
+}
+
+static bool computeReady(Pipeline* pl, const PipeWait* pw) {
+	return pw->pos != atomic_load_explicit(&pw->ring->ingested, memory_order_acquire) || atomic_load_explicit(&pl->stop, memory_order_relaxed) || atomic_load_explicit(&pl->done, memory_order_acquire);
+}
+
+static bool applyReady(Pipeline* pl, const PipeWait* pw) {
+	return pw->pos != atomic_load_explicit(&pw->ring->computed, memory_order_acquire) || (atomic_load_explicit(&pl->done, memory_order_acquire) && pl->next >= atomic_load_explicit(&pl->total, memory_order_relaxed));
+}
+
+// the files are dealt out in turns, so the order is kept by collecting them in the same turns
+static void* readPipeProc(Pipeline* pl) {
+	size_t cnt = 0;
+	for (; !atomic_load_explicit(&pl->stop, memory_order_relaxed); ++cnt) {
+		PipeRing* ring = &pl->rings[cnt % pl->nWorkers];
+		size_t pos = atomic_load_explicit(&ring->ingested, memory_order_relaxed);
+		waitPipe(pl, readReady, ring, pos);
+		if (atomic_load_explicit(&pl->stop, memory_order_relaxed) || !pl->ingest(pl->data, &ring->items[pos % PIPE_RING_SIZE]))
+			break;
+		atomic_store_explicit(&ring->ingested, pos + 1, memory_order_release);
+		wakePipe(pl);
+	}
+	atomic_store_explicit(&pl->total, cnt, memory_order_relaxed);
+	atomic_store_explicit(&pl->done, true, memory_order_release);
+	wakePipe(pl);
+	return NULL;
+}
+
+static void* computePipeProc(PipeWorker* pw) {
+	Pipeline* pl = pw->pl;
+	PipeRing* ring = &pl->rings[pw->id];
+	for (size_t pos = 0; !atomic_load_explicit(&pl->stop, memory_order_relaxed); ++pos) {
+		waitPipe(pl, computeReady, ring, pos);
+		if (atomic_load_explicit(&pl->stop, memory_order_relaxed) || pos == atomic_load_explicit(&ring->ingested, memory_order_acquire))
+			return NULL;
+		pl->compute(pl->data, pw->id, &ring->items[pos % PIPE_RING_SIZE]);
+		atomic_store_explicit(&ring->computed, pos + 1, memory_order_release);
+		wakePipe(pl);
+	}
+	return NULL;
+}
+
+Pipeline* startPipeline(size_t workers, PipeIngest ingest, PipeCompute compute, void* data) {
+	Pipeline* pl = malloc(sizeof(Pipeline));
+	pl->rings = malloc(workers * sizeof(PipeRing));
+	pl->workers = malloc(workers * sizeof(PipeWorker));
+	pl->ingest = ingest;
+	pl->compute = compute;
+	pl->data = data;
+	pl->current = NULL;
+	pl->nWorkers = workers;
+	pl->next = 0;
+	g_mutex_init(&pl->mutex);
+	g_cond_init(&pl->cond);
+	atomic_init(&pl->sleepers, 0);
+	atomic_init(&pl->total, 0);
+	atomic_init(&pl->done, false);
+	atomic_init(&pl->stop, false);
+	for (size_t i = 0; i < workers; ++i) {
+		pl->rings[i].items = calloc(PIPE_RING_SIZE, sizeof(PipeItem));
+		atomic_init(&pl->rings[i].ingested, 0);
+		atomic_init(&pl->rings[i].computed, 0);
+		atomic_init(&pl->rings[i].applied, 0);
+	}
+	for (size_t i = 0; i < workers; ++i) {
+		pl->workers[i].pl = pl;
+		pl->workers[i].id = i;
+		pl->workers[i].thread = g_thread_new("compute", (GThreadFunc)computePipeProc, &pl->workers[i]);
+	}
+	pl->reader = g_thread_new("ingest", (GThreadFunc)readPipeProc, pl);
+	return pl;
+}
+
+// the returned item stays valid until the next call, which gives its slot back to the reader
+PipeItem* nextPipeItem(Pipeline* pl) {
+	if (pl->current) {
+		atomic_fetch_add_explicit(&pl->current->applied, 1, memory_order_release);
+		wakePipe(pl);
+	}
+
+	PipeRing* ring = &pl->rings[pl->next % pl->nWorkers];
+	size_t pos = pl->next / pl->nWorkers;
+	waitPipe(pl, applyReady, ring, pos);
+	if (pos == atomic_load_explicit(&ring->computed, memory_order_acquire)) {
+		pl->current = NULL;
+		return NULL;
+	}
+	pl->current = ring;
+	++pl->next;
+	return &ring->items[pos % PIPE_RING_SIZE];
+}
+
+// the reader has to be woken by the caller if it may be blocked on its input
+void stopPipeline(Pipeline* pl) {
+	atomic_store_explicit(&pl->stop, true, memory_order_relaxed);
+	wakePipe(pl);
+	g_thread_join(pl->reader);
+	for (size_t i = 0; i < pl->nWorkers; ++i) {
+		g_thread_join(pl->workers[i].thread);
+		// the messages of the items that haven't been taken are still owned by the ring
+		for (size_t j = 0; j < PIPE_RING_SIZE; ++j)
+			g_free(pl->rings[i].items[j].message);
+		free(pl->rings[i].items);
+	}
+	g_cond_clear(&pl->cond);
+	g_mutex_clear(&pl->mutex);
+	free(pl->workers);
+	free(pl->rings);
+	free(pl);
+}
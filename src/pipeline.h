@@ -0,0 +1,30 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "utils.h"
+
+#define PIPELINE_WORKERS_MAX 64
+
+typedef struct Pipeline Pipeline;
+
+typedef struct PipeItem {
+	size_t id;
+	size_t plen;
+	size_t nameLen;
+	size_t rule;
+	char* message;
+	int error;
+	ResponseType rc;
+	FileMeta meta;
+	char original[PATH_MAX];
+	char name[FILENAME_MAX];
+} PipeItem;
+
+typedef bool (*PipeIngest)(void* data, PipeItem* item);
+typedef void (*PipeCompute)(void* data, size_t worker, PipeItem* item);
+
+Pipeline* startPipeline(size_t workers, PipeIngest ingest, PipeCompute compute, void* data);
+PipeItem* nextPipeItem(Pipeline* pl);
+void stopPipeline(Pipeline* pl);
+
+#endif
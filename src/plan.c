@@ -0,0 +1,364 @@
+#include "plan.h"
+#include "journal.h"
+#include "rename.h"
+#include "verify.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+#define PLAN_MAGIC 0x50424653
+#define PLAN_VERSION 1
+#define PLAN_BUFFER_SIZE (256 * 1024)
+#define PARKING_PREFIX ".sfbrename-"
+
+typedef struct PlanHeader {
+	uint32_t magic;
+	uint32_t version;
+} PlanHeader;
+
+typedef enum PlanVisit {
+	PLAN_UNSEEN,
+	PLAN_PATH,
+	PLAN_DONE
+} PlanVisit;
+
+struct Plan {
+	FILE* fd;
+	char* workDir;
+	PlanEntry* entries;
+	size_t count;
+	size_t lim;
+};
+
+static FILE* createPlan(const char* path, Window* win) {
+	FILE* fd = fopen(path, "wb");
+	if (!fd) {
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to create plan '%s': %s", path, strerror(errno));
+		return NULL;
+	}
+	setvbuf(fd, NULL, _IOFBF, PLAN_BUFFER_SIZE);
+	PlanHeader head = { PLAN_MAGIC, PLAN_VERSION };
+	fwrite(&head, sizeof(head), 1, fd);
+	return fd;
+}
+
+static bool finishPlan(FILE* fd, const char* path, Window* win) {
+	bool ok = !fflush(fd) && !ferror(fd);
+	if (!ok)
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to write plan '%s': %s", path, strerror(errno));
+	fclose(fd);
+	return ok;
+}
+
+static void writePlanRecord(FILE* fd, uint8_t mode, uint64_t dev, uint64_t ino, const char* src, const char* dst) {
+	fwrite(&mode, sizeof(mode), 1, fd);
+	fwrite(&dev, sizeof(dev), 1, fd);
+	fwrite(&ino, sizeof(ino), 1, fd);
+	writeRecordString(fd, src);
+	writeRecordString(fd, dst);
+}
+
+static void writePlanEntry(FILE* fd, const PlanEntry* it) {
+	writePlanRecord(fd, it->mode, it->dev, it->ino, it->src, it->dst);
+}
+
+bool openPlan(Process* prc, const char* path, Window* win) {
+	FILE* fd = createPlan(path, win);
+	if (!fd)
+		return false;
+
+	prc->plan = malloc(sizeof(Plan));
+	prc->plan->fd = fd;
+	prc->plan->workDir = workingDirectory();
+	prc->plan->lim = 64;
+	prc->plan->count = 0;
+	prc->plan->entries = malloc(prc->plan->lim * sizeof(PlanEntry));
+	return true;
+}
+
+// a plan may be applied from another directory, so relative paths get the working directory in front
+static char* copyAbsolute(char* buf, const char* dir, size_t dlen, const char* path) {
+	if (!g_path_is_absolute(path)) {
+		for (; path[0] == '.' && path[1] == '/'; path += 2);
+		memcpy(buf, dir, dlen * sizeof(char));
+		buf[dlen] = '/';
+		buf += dlen + 1;
+	}
+	size_t plen = strlen(path) + 1;
+	memcpy(buf, path, plen * sizeof(char));
+	return buf + plen;
+}
+
+// the renames are kept until the plan is closed, because they can only be ordered once all of them are known
+void writePlan(Process* prc, uint64_t dev, uint64_t ino) {
+	Plan* plan = prc->plan;
+	if (plan->count == plan->lim) {
+		plan->lim *= 2;
+		plan->entries = realloc(plan->entries, plan->lim * sizeof(PlanEntry));
+	}
+
+	size_t wlen = strlen(plan->workDir);
+	char* buf = malloc((strlen(prc->original) + strlen(prc->dstdir) + 2 * wlen + 4) * sizeof(char));
+	char* dst = copyAbsolute(buf, plan->workDir, wlen, prc->original);
+	copyAbsolute(dst, plan->workDir, wlen, prc->dstdir);
+	plan->entries[plan->count++] = (PlanEntry){ buf, dst, dev, ino, prc->destinationMode };
+}
+
+static bool isVacating(DestinationMode mode) {
+	return mode == DESTINATION_IN_PLACE || mode == DESTINATION_MOVE;
+}
+
+// a rename has to wait for the one that moves away the file at its destination, so every rename depends on at most one other
+static size_t* linkPlan(const PlanEntry* entries, size_t count) {
+	GHashTable* srcs = g_hash_table_new(g_str_hash, g_str_equal);
+	for (size_t i = 0; i < count; ++i)
+		if (isVacating(entries[i].mode))
+			g_hash_table_insert(srcs, (char*)entries[i].src, GSIZE_TO_POINTER(i + 1));
+
+	size_t* deps = malloc(count * sizeof(size_t));
+	for (size_t i = 0; i < count; ++i) {
+		size_t j = GPOINTER_TO_SIZE(g_hash_table_lookup(srcs, entries[i].dst));
+		deps[i] = j && j - 1 != i ? j - 1 : SIZE_MAX;
+	}
+	g_hash_table_destroy(srcs);
+	return deps;
+}
+
+static bool nameTaken(const char* path) {
+	struct stat ps;
+#ifdef _WIN32
+	return !stat(path, &ps);
+#else
+	return !lstat(path, &ps);
+#endif
+}
+
+static void makeParkingName(char* tmp, const char* src, size_t* cnt) {
+	const char* sep = strrchr(src, '/');
+	int dlen = sep ? (int)(sep - src + 1) : 0;
+	do {
+		snprintf(tmp, PATH_MAX, "%.*s" PARKING_PREFIX "%zu", dlen, src, (*cnt)++);
+	} while (nameTaken(tmp));
+}
+
+static bool isParkingName(const char* path) {
+	const char* sep = strrchr(path, '/');
+	const char* name = sep ? sep + 1 : path;
+	if (strncmp(name, PARKING_PREFIX, sizeof(PARKING_PREFIX) - 1))
+		return false;
+	name += sizeof(PARKING_PREFIX) - 1;
+	return *name && !name[strspn(name, "0123456789")];
+}
+
+// a parking name was only free when the plan was made, so one that has been taken since is swapped for a new one together with the entry that moves the file on
+GPtrArray* reparkPlan(PlanEntry* entries, size_t count) {
+	GPtrArray* names = g_ptr_array_new_with_free_func(g_free);
+	size_t parked = count;
+	for (size_t i = 0; i < count; ++i) {
+		if (!isVacating(entries[i].mode) || !isParkingName(entries[i].dst) || !nameTaken(entries[i].dst))
+			continue;
+
+		char* tmp = g_malloc(PATH_MAX * sizeof(char));
+		makeParkingName(tmp, entries[i].src, &parked);
+		for (size_t j = i + 1; j < count; ++j)
+			if (!strcmp(entries[j].src, entries[i].dst)) {
+				entries[j].src = tmp;
+				break;
+			}
+		entries[i].dst = tmp;
+		g_ptr_array_add(names, tmp);
+	}
+	return names;
+}
+
+// every chain is written from its free end, whereas a cycle first parks one file under a temporary name and moves it to its new name last
+static void writeOrderedPlan(FILE* fd, const PlanEntry* entries, size_t count) {
+	size_t* deps = linkPlan(entries, count);
+	uint8_t* visits = calloc(count, sizeof(uint8_t));
+	size_t* path = malloc(count * sizeof(size_t));
+	size_t parked = 0;
+	char tmp[PATH_MAX];
+	for (size_t i = 0; i < count; ++i) {
+		size_t len = 0;
+		size_t j = i;
+		for (; j != SIZE_MAX && visits[j] == PLAN_UNSEEN; j = deps[j]) {
+			visits[j] = PLAN_PATH;
+			path[len++] = j;
+		}
+
+		size_t end = len;
+		if (j != SIZE_MAX && visits[j] == PLAN_PATH) {
+			for (end = len; path[--end] != j;);
+			makeParkingName(tmp, entries[j].src, &parked);
+			PlanEntry park = entries[j];
+			park.dst = tmp;
+			writePlanEntry(fd, &park);
+			for (size_t k = len - 1; k > end; --k) {
+				writePlanEntry(fd, &entries[path[k]]);
+				visits[path[k]] = PLAN_DONE;
+			}
+			park.src = tmp;
+			park.dst = entries[j].dst;
+			writePlanEntry(fd, &park);
+			visits[j] = PLAN_DONE;
+		}
+		while (end--) {
+			writePlanEntry(fd, &entries[path[end]]);
+			visits[path[end]] = PLAN_DONE;
+		}
+	}
+	free(path);
+	free(visits);
+	free(deps);
+}
+
+void closePlan(Process* prc, const char* path, Window* win) {
+	Plan* plan = prc->plan;
+	if (plan) {
+		writeOrderedPlan(plan->fd, plan->entries, plan->count);
+		finishPlan(plan->fd, path, win);
+		for (size_t i = 0; i < plan->count; ++i)
+			free((char*)plan->entries[i].src);
+		free(plan->entries);
+		g_free(plan->workDir);
+		free(plan);
+		prc->plan = NULL;
+	}
+}
+
+PlanEntry* loadPlan(const char* path, GMappedFile** map, size_t* count, Window* win) {
+	GError* err = NULL;
+	*map = g_mapped_file_new(path, false, &err);
+	if (!*map) {
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to open plan '%s': %s", path, err->message);
+		g_clear_error(&err);
+		return NULL;
+	}
+
+	const char* pos = g_mapped_file_get_contents(*map);
+	const char* end = pos + g_mapped_file_get_length(*map);
+	PlanHeader head = { 0, 0 };
+	if (end - pos >= (ptrdiff_t)sizeof(head))
+		memcpy(&head, pos, sizeof(head));
+	if (head.magic != PLAN_MAGIC || head.version > PLAN_VERSION) {
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "'%s' is not a valid plan", path);
+		g_mapped_file_unref(*map);
+		return NULL;
+	}
+	pos += sizeof(head);
+
+	size_t lim = 64;
+	PlanEntry* entries = malloc(lim * sizeof(PlanEntry));
+	*count = 0;
+	while (pos < end) {
+		PlanEntry it;
+		const char* next = pos + sizeof(uint8_t) + sizeof(it.dev) + sizeof(it.ino);
+		if (next > end || (uint8_t)*pos > DESTINATION_HARDLINK || !(it.src = readRecordString(&next, end)) || !(it.dst = readRecordString(&next, end))) {
+			// unlike a journal, a plan is written in one go, so anything unreadable means it's been damaged
+			showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Plan '%s' is damaged at entry %zu", path, *count);
+			free(entries);
+			g_mapped_file_unref(*map);
+			return NULL;
+		}
+		it.mode = (uint8_t)*pos;
+		memcpy(&it.dev, pos + sizeof(uint8_t), sizeof(it.dev));
+		memcpy(&it.ino, pos + sizeof(uint8_t) + sizeof(it.dev), sizeof(it.ino));
+
+		if (*count == lim) {
+			lim *= 2;
+			entries = realloc(entries, lim * sizeof(PlanEntry));
+		}
+		entries[(*count)++] = it;
+		pos = next;
+	}
+	return entries;
+}
+
+static size_t findGroup(size_t* groups, size_t i) {
+	while (groups[i] != i)
+		i = groups[i] = groups[groups[i]];
+	return i;
+}
+
+static void joinDirectory(GHashTable* dirs, size_t* groups, const char* path, size_t i) {
+	const char* sep = strrchr(path, '/');
+	char* dir = g_strndup(path, sep ? (size_t)(sep - path) : 0);
+	size_t j = GPOINTER_TO_SIZE(g_hash_table_lookup(dirs, dir));
+	if (!j) {
+		g_hash_table_insert(dirs, dir, GSIZE_TO_POINTER(i + 1));
+		return;
+	}
+
+	g_free(dir);
+	size_t a = findGroup(groups, i);
+	size_t b = findGroup(groups, j - 1);
+	groups[MAX(a, b)] = MIN(a, b);
+}
+
+// entries that share a source or destination directory, even through other entries, form a group that has to stay in one shard to keep its order
+static size_t* groupPlan(const PlanEntry* entries, size_t count) {
+	GHashTable* dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	size_t* groups = malloc(count * sizeof(size_t));
+	for (size_t i = 0; i < count; ++i) {
+		groups[i] = i;
+		joinDirectory(dirs, groups, entries[i].src, i);
+		joinDirectory(dirs, groups, entries[i].dst, i);
+	}
+	g_hash_table_destroy(dirs);
+	return groups;
+}
+
+static void removeShards(char* name, const char* path, size_t plen, size_t shards) {
+	for (size_t i = 0; i < shards; ++i) {
+		snprintf(name, plen + MAX_DIGITS_I32D + 2, "%s.%zu", path, i);
+		remove(name);
+	}
+}
+
+bool splitPlan(const char* path, size_t shards, bool verbose) {
+	GMappedFile* map;
+	size_t count;
+	PlanEntry* entries = loadPlan(path, &map, &count, NULL);
+	if (!entries)
+		return false;
+
+	size_t plen = strlen(path);
+	char* name = malloc((plen + MAX_DIGITS_I32D + 2) * sizeof(char));
+	FILE** fds = calloc(shards, sizeof(FILE*));
+	bool ok = true;
+	size_t opened = 0;
+	for (; opened < shards; ++opened) {
+		snprintf(name, plen + MAX_DIGITS_I32D + 2, "%s.%zu", path, opened);
+		if (!(fds[opened] = createPlan(name, NULL))) {
+			ok = false;
+			break;
+		}
+	}
+
+	// a group goes to the shard of its first entry's destination directory, so no two shards touch one directory
+	size_t* groups = groupPlan(entries, count);
+	for (size_t i = 0; i < count && ok; ++i) {
+		const char* dst = entries[findGroup(groups, i)].dst;
+		const char* sep = strrchr(dst, '/');
+		HashState hs;
+		hashInit(&hs);
+		hashUpdate(&hs, dst, sep ? (size_t)(sep - dst) : 0);
+		writePlanRecord(fds[hashDigest(&hs) % shards], entries[i].mode, entries[i].dev, entries[i].ino, entries[i].src, entries[i].dst);
+	}
+	free(groups);
+
+	for (size_t i = 0; i < shards && fds[i]; ++i) {
+		snprintf(name, plen + MAX_DIGITS_I32D + 2, "%s.%zu", path, i);
+		ok = finishPlan(fds[i], name, NULL) && ok;
+	}
+	// shards that don't add up to the whole plan must not be applied by mistake
+	if (!ok)
+		removeShards(name, path, plen, opened);
+	else if (verbose)
+		for (size_t i = 0; i < shards; ++i)
+			g_print("%s.%zu\n", path, i);
+	free(fds);
+	free(name);
+	free(entries);
+	g_mapped_file_unref(map);
+	return ok;
+}
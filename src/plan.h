@@ -0,0 +1,23 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include "utils.h"
+
+#define PLAN_SHARDS_MAX 512
+
+typedef struct PlanEntry {
+	const char* src;
+	const char* dst;
+	uint64_t dev;
+	uint64_t ino;
+	DestinationMode mode;
+} PlanEntry;
+
+bool openPlan(Process* prc, const char* path, Window* win);
+void writePlan(Process* prc, uint64_t dev, uint64_t ino);
+void closePlan(Process* prc, const char* path, Window* win);
+PlanEntry* loadPlan(const char* path, GMappedFile** map, size_t* count, Window* win);
+GPtrArray* reparkPlan(PlanEntry* entries, size_t count);
+bool splitPlan(const char* path, size_t shards, bool verbose);
+
+#endif
@@ -0,0 +1,165 @@
+#include "policy.h"
+#include <errno.h>
+
+typedef struct ErrorCode {
+	const char* name;
+	int code;
+} ErrorCode;
+
+struct ErrorReport {
+	GString* text;
+	size_t count;
+};
+
+static const ErrorCode errorCodes[] = {
+	{ "EPERM", EPERM },
+	{ "ENOENT", ENOENT },
+	{ "EIO", EIO },
+	{ "EAGAIN", EAGAIN },
+	{ "EACCES", EACCES },
+	{ "EBUSY", EBUSY },
+	{ "EEXIST", EEXIST },
+	{ "EXDEV", EXDEV },
+	{ "ENOTDIR", ENOTDIR },
+	{ "EISDIR", EISDIR },
+	{ "EINVAL", EINVAL },
+#ifdef ETXTBSY
+	{ "ETXTBSY", ETXTBSY },
+#endif
+	{ "EFBIG", EFBIG },
+	{ "ENOSPC", ENOSPC },
+	{ "EROFS", EROFS },
+	{ "EMLINK", EMLINK },
+	{ "ENAMETOOLONG", ENAMETOOLONG },
+	{ "ENOTEMPTY", ENOTEMPTY },
+#ifdef ELOOP
+	{ "ELOOP", ELOOP },
+#endif
+#ifdef EDQUOT
+	{ "EDQUOT", EDQUOT },
+#endif
+#ifdef ESTALE
+	{ "ESTALE", ESTALE },
+#endif
+};
+
+static const char* const actionNames[] = { "ask", "skip", "abort", "retry", "overwrite", "collect" };
+
+static int parseErrorCode(const char* name) {
+	if (!strcmp(name, "*"))
+		return ERROR_CODES_MAX;
+	for (size_t i = 0; i < G_N_ELEMENTS(errorCodes); ++i)
+		if (!strcasecmp(name, errorCodes[i].name))
+			return errorCodes[i].code < ERROR_CODES_MAX ? errorCodes[i].code : -1;
+
+	char* end;
+	long code = strtol(name, &end, 10);
+	return *name && !*end && code > 0 && code < ERROR_CODES_MAX ? (int)code : -1;
+}
+
+static int parseErrorAction(const char* name) {
+	for (size_t i = 0; i < G_N_ELEMENTS(actionNames); ++i)
+		if (!strcasecmp(name, actionNames[i]))
+			return (int)i;
+	return -1;
+}
+
+// the policy is a list like "ENOENT=skip,EBUSY=retry,*=collect", where '*' stands for all of the other errors
+bool parseErrorPolicy(ErrorPolicy* ep, gchar* str, GError** err) {
+	memset(ep, ERROR_ASK, sizeof(ErrorPolicy));
+	ep->used = false;
+	if (!str)
+		return true;
+
+	bool ok = true;
+	char** items = g_strsplit(str, ",", -1);
+	for (char** it = items; *it && ok; ++it) {
+		char* sep = strchr(*it, '=');
+		if (!sep) {
+			if (*g_strstrip(*it)) {
+				g_set_error(err, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "Invalid error policy '%s'", *it);
+				ok = false;
+			}
+			continue;
+		}
+
+		*sep = '\0';
+		int code = parseErrorCode(g_strstrip(*it));
+		int act = parseErrorAction(g_strstrip(sep + 1));
+		if (code < 0 || act < 0) {
+			g_set_error(err, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "Invalid error policy '%s=%s'", *it, sep + 1);
+			ok = false;
+			continue;
+		}
+		if (code == ERROR_CODES_MAX)
+			ep->fallback = act;
+		else
+			ep->actions[code] = act;
+		ep->used = true;
+	}
+	g_strfreev(items);
+	g_free(str);
+	return ok;
+}
+
+static bool isTransient(int err) {
+#ifdef ESTALE
+	if (err == ESTALE)
+		return true;
+#endif
+	return err == EBUSY || err == EAGAIN;
+}
+
+// errors that tend to go away on their own, like those of a busy network mount, are retried unless the policy names them
+ErrorAction errorAction(const ErrorPolicy* ep, int err) {
+	if (ep && err > 0 && err < ERROR_CODES_MAX && ep->actions[err] != ERROR_ASK)
+		return ep->actions[err];
+	if (isTransient(err))
+		return ERROR_RETRY;
+	return ep ? ep->fallback : ERROR_ASK;
+}
+
+ErrorAction exhaustedAction(const ErrorPolicy* ep) {
+	return ep && ep->fallback != ERROR_RETRY && ep->fallback != ERROR_OVERWRITE ? ep->fallback : ERROR_ASK;
+}
+
+const char* errorName(int err) {
+	for (size_t i = 0; i < G_N_ELEMENTS(errorCodes); ++i)
+		if (errorCodes[i].code == err)
+			return errorCodes[i].name;
+	return "EOTHER";
+}
+
+ErrorReport* newErrorReport(void) {
+	ErrorReport* er = malloc(sizeof(ErrorReport));
+	er->text = g_string_new(NULL);
+	er->count = 0;
+	return er;
+}
+
+// every line holds the source, the destination, the error's name and its message separated by tabs
+void collectError(ErrorReport* er, const char* src, const char* dst, int err) {
+	g_string_append_printf(er->text, "%s\t%s\t%s\t%s\n", src, dst, errorName(err), g_strerror(err));
+	++er->count;
+}
+
+bool finishErrorReport(ErrorReport* er, const char* path) {
+	if (!er)
+		return true;
+
+	bool ok = true;
+	if (er->count) {
+		if (path) {
+			GError* err = NULL;
+			if (!(ok = g_file_set_contents(path, er->text->str, er->text->len, &err))) {
+				g_printerr("Failed to write error report '%s': %s\n", path, err->message);
+				g_clear_error(&err);
+			}
+		} else
+			g_printerr("%s", er->text->str);
+		g_printerr("%zu files failed\n", er->count);
+	}
+	g_string_free(er->text, TRUE);
+	free(er);
+	return ok;
+}
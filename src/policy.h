@@ -0,0 +1,31 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include "utils.h"
+
+#define ERROR_CODES_MAX 256
+
+typedef enum ErrorAction {
+	ERROR_ASK,
+	ERROR_SKIP,
+	ERROR_ABORT,
+	ERROR_RETRY,
+	ERROR_OVERWRITE,
+	ERROR_COLLECT
+} ErrorAction;
+
+struct ErrorPolicy {
+	uint8_t actions[ERROR_CODES_MAX];
+	uint8_t fallback;
+	bool used;
+};
+
+bool parseErrorPolicy(ErrorPolicy* ep, gchar* str, GError** err);
+ErrorAction errorAction(const ErrorPolicy* ep, int err);
+ErrorAction exhaustedAction(const ErrorPolicy* ep);
+const char* errorName(int err);
+ErrorReport* newErrorReport(void);
+void collectError(ErrorReport* er, const char* src, const char* dst, int err);
+bool finishErrorReport(ErrorReport* er, const char* path);
+
+#endif
@@ -0,0 +1,193 @@
+#include "preflight.h"
+#include "progress.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/statvfs.h>
+#include <unistd.h>
+#endif
+
+#define PREFLIGHT_REPORT_MAX 100
+#ifndef NAME_MAX
+#define NAME_MAX 255
+#endif
+
+typedef struct PreflightDir {
+	char* path;
+	size_t* items;
+	size_t count;
+	size_t lim;
+	uint64_t bytes;
+	uint64_t avail;
+	uint64_t dev;
+	GString* problems;
+	size_t nProblems;
+} PreflightDir;
+
+typedef struct Preflight {
+	const PlanEntry* entries;
+	GHashTable* vacated;
+	GPtrArray* dirs;
+	bool existing;
+} Preflight;
+
+static void addProblem(GString** problems, size_t* cnt, const char* format, ...) {
+	if (!*problems)
+		*problems = g_string_new(NULL);
+	if (++*cnt <= PREFLIGHT_REPORT_MAX) {
+		va_list args;
+		va_start(args, format);
+		g_string_append_vprintf(*problems, format, args);
+		va_end(args);
+		g_string_append_c(*problems, '\n');
+	}
+}
+
+static PreflightDir* groupDirectory(GHashTable* groups, GPtrArray* dirs, const char* path) {
+	const char* sep = strrchr(path, '/');
+	char* key = sep ? g_strndup(path, sep != path ? (size_t)(sep - path) : 1) : g_strdup(".");
+	PreflightDir* dir = g_hash_table_lookup(groups, key);
+	if (dir) {
+		g_free(key);
+		return dir;
+	}
+
+	dir = calloc(1, sizeof(PreflightDir));
+	dir->path = key;
+	dir->lim = 16;
+	dir->items = malloc(dir->lim * sizeof(size_t));
+	g_hash_table_insert(groups, key, dir);
+	g_ptr_array_add(dirs, dir);
+	return dir;
+}
+
+static GHashTable* listDirectory(const char* path) {
+	GHashTable* names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	DIR* dp = opendir(path);
+	if (dp) {
+		for (struct dirent* entry = readdir(dp); entry; entry = readdir(dp))
+			g_hash_table_add(names, g_strdup(entry->d_name));
+		closedir(dp);
+	}
+	return names;
+}
+
+// a target directory is listed once for all of its renames instead of looking up every new name on its own
+static void checkDirectory(PreflightDir* dir, Preflight* pf) {
+	struct stat ps;
+	if (stat(dir->path, &ps) || !S_ISDIR(ps.st_mode)) {
+		addProblem(&dir->problems, &dir->nProblems, "Directory '%s' doesn't exist", dir->path);
+		return;
+	}
+	dir->dev = ps.st_dev;
+#ifndef _WIN32
+	if (access(dir->path, W_OK))
+		addProblem(&dir->problems, &dir->nProblems, "Directory '%s' isn't writable: %s", dir->path, g_strerror(errno));
+	struct statvfs fs;
+	dir->avail = statvfs(dir->path, &fs) ? UINT64_MAX : (uint64_t)fs.f_bavail * fs.f_frsize;
+#else
+	dir->avail = UINT64_MAX;
+#endif
+
+	GHashTable* names = listDirectory(dir->path);
+	for (size_t i = 0; i < dir->count; ++i) {
+		const PlanEntry* it = &pf->entries[dir->items[i]];
+		const char* name = strrchr(it->dst, '/');
+		name = name ? name + 1 : it->dst;
+		if (strlen(name) > NAME_MAX)
+			addProblem(&dir->problems, &dir->nProblems, "Name '%s' is too long", name);
+		else if (pf->existing && g_hash_table_contains(names, name) && strcmp(it->src, it->dst) && !g_hash_table_contains(pf->vacated, it->dst))
+			addProblem(&dir->problems, &dir->nProblems, "'%s' already exists", it->dst);
+		// a hard link only takes space when it has to fall back to a copy across file systems
+		if (it->mode == DESTINATION_COPY || (it->mode == DESTINATION_HARDLINK && it->dev != dir->dev))
+			dir->bytes += measureFile(it->src);
+	}
+	g_hash_table_destroy(names);
+}
+
+static void freePreflightDir(PreflightDir* dir) {
+	if (dir->problems)
+		g_string_free(dir->problems, TRUE);
+	free(dir->items);
+	free(dir);
+}
+
+// the whole plan is checked before anything is applied, so that a run doesn't stop after doing most of its irreversible renames
+// a normal run may overwrite existing files on purpose, so only a plan is refused for them
+bool preflightPlan(const PlanEntry* entries, size_t count, bool existing, Window* win) {
+	Preflight pf = { entries, g_hash_table_new(g_str_hash, g_str_equal), g_ptr_array_new_with_free_func((GDestroyNotify)freePreflightDir), existing };
+	GHashTable* groups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	GHashTable* targets = g_hash_table_new(g_str_hash, g_str_equal);
+	GString* problems = NULL;
+	size_t nProblems = 0;
+	for (size_t i = 0; i < count; ++i)
+		if (entries[i].mode == DESTINATION_IN_PLACE || entries[i].mode == DESTINATION_MOVE)
+			g_hash_table_add(pf.vacated, (char*)entries[i].src);
+	for (size_t i = 0; i < count; ++i) {
+		const PlanEntry* first = g_hash_table_lookup(targets, entries[i].dst);
+		if (first) {
+			addProblem(&problems, &nProblems, "Both '%s' and '%s' would become '%s'", first->src, entries[i].src, entries[i].dst);
+			continue;
+		}
+		g_hash_table_insert(targets, (char*)entries[i].dst, (gpointer)&entries[i]);
+
+		PreflightDir* dir = groupDirectory(groups, pf.dirs, entries[i].dst);
+		if (dir->count == dir->lim) {
+			dir->lim *= 2;
+			dir->items = realloc(dir->items, dir->lim * sizeof(size_t));
+		}
+		dir->items[dir->count++] = i;
+	}
+	g_hash_table_destroy(targets);
+
+	GThreadPool* pool = g_thread_pool_new((GFunc)checkDirectory, &pf, (int)g_get_num_processors(), FALSE, NULL);
+	for (guint i = 0; i < pf.dirs->len; ++i)
+		g_thread_pool_push(pool, pf.dirs->pdata[i], NULL);
+	g_thread_pool_free(pool, FALSE, TRUE);
+
+	// directories on the same file system share its free space
+	GHashTable* devs = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, NULL);
+	for (guint i = 0; i < pf.dirs->len; ++i) {
+		PreflightDir* dir = pf.dirs->pdata[i];
+		if (dir->problems) {
+			if (nProblems < PREFLIGHT_REPORT_MAX) {
+				if (!problems)
+					problems = g_string_new(NULL);
+				g_string_append(problems, dir->problems->str);
+			}
+			nProblems += dir->nProblems;
+		}
+		if (dir->bytes) {
+			PreflightDir* first = g_hash_table_lookup(devs, &dir->dev);
+			if (first)
+				first->bytes += dir->bytes;
+			else
+				g_hash_table_insert(devs, &dir->dev, dir);
+		}
+	}
+
+	GHashTableIter it;
+	PreflightDir* dir;
+	g_hash_table_iter_init(&it, devs);
+	while (g_hash_table_iter_next(&it, NULL, (gpointer*)&dir))
+		if (dir->bytes > dir->avail) {
+			char* need = g_format_size(dir->bytes);
+			char* avail = g_format_size(dir->avail);
+			addProblem(&problems, &nProblems, "Not enough space for the copies in '%s', %s are needed but only %s are free", dir->path, need, avail);
+			g_free(need);
+			g_free(avail);
+		}
+	g_hash_table_destroy(devs);
+
+	if (problems) {
+		if (nProblems > PREFLIGHT_REPORT_MAX)
+			g_string_append_printf(problems, "and %zu more problems\n", nProblems - PREFLIGHT_REPORT_MAX);
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Nothing has been renamed because of %zu problems:\n%s", nProblems, problems->str);
+		g_string_free(problems, TRUE);
+	}
+	g_ptr_array_free(pf.dirs, TRUE);
+	g_hash_table_destroy(groups);
+	g_hash_table_destroy(pf.vacated);
+	return !problems;
+}
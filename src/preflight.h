@@ -0,0 +1,8 @@
+#ifndef PREFLIGHT_H
+#define PREFLIGHT_H
+
+#include "plan.h"
+
+bool preflightPlan(const PlanEntry* entries, size_t count, bool existing, Window* win);
+
+#endif
@@ -0,0 +1,114 @@
+#include "progress.h"
+#include "rename.h"
+#include <dirent.h>
+#include <sys/stat.h>
+
+static uint64_t measurePath(char* path, size_t plen) {
+	struct stat ps;
+#ifdef _WIN32
+	if (stat(path, &ps))
+#else
+	if (lstat(path, &ps))
+#endif
+		return 0;
+	if (!S_ISDIR(ps.st_mode))
+		return S_ISREG(ps.st_mode) ? (uint64_t)ps.st_size : 0;
+
+	uint64_t size = 0;
+	DIR* dir = opendir(path);
+	if (dir) {
+		path[plen] = '/';
+		for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir))
+			if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+				size_t nlen = strlen(entry->d_name);
+				if (plen + nlen + 1 < PATH_MAX) {
+					memcpy(path + plen + 1, entry->d_name, (nlen + 1) * sizeof(char));
+					size += measurePath(path, plen + nlen + 1);
+				}
+			}
+		path[plen] = '\0';
+		closedir(dir);
+	}
+	return size;
+}
+
+uint64_t measureFile(const char* path) {
+	char buf[PATH_MAX];
+	size_t plen = strlen(path);
+	if (plen >= PATH_MAX)
+		return 0;
+	memcpy(buf, path, (plen + 1) * sizeof(char));
+	return measurePath(buf, plen);
+}
+
+void initProgress(Process* prc, uint64_t total) {
+	atomic_store_explicit(&prc->bytesDone, 0, memory_order_relaxed);
+	atomic_store_explicit(&prc->bytesTotal, total, memory_order_relaxed);
+	prc->progressStart = g_get_monotonic_time();
+}
+
+double progressFraction(const Process* prc) {
+	uint64_t total = atomic_load_explicit(&prc->bytesTotal, memory_order_relaxed);
+	return total ? MIN((double)atomic_load_explicit(&prc->bytesDone, memory_order_relaxed) / (double)total, 1.0) : 0.0;
+}
+
+static void formatBytes(char* text, size_t size, double val) {
+	static const char* const units[] = { "B", "KB", "MB", "GB", "TB", "PB" };
+	uint i = 0;
+	for (; val >= 1000.0 && i < sizeof(units) / sizeof(*units) - 1; ++i)
+		val /= 1000.0;
+	snprintf(text, size, i ? "%.1f %s" : "%.0f %s", val, units[i]);
+}
+
+int formatProgress(const Process* prc, char* text, size_t size) {
+	uint64_t done = atomic_load_explicit(&prc->bytesDone, memory_order_relaxed);
+	uint64_t total = atomic_load_explicit(&prc->bytesTotal, memory_order_relaxed);
+	double secs = (double)(g_get_monotonic_time() - prc->progressStart) / (double)G_TIME_SPAN_SECOND;
+	double rate = secs > 0.0 ? (double)done / secs : 0.0;
+	char sdone[16], stotal[16], srate[16];
+	formatBytes(sdone, sizeof(sdone), (double)done);
+	formatBytes(stotal, sizeof(stotal), (double)total);
+	formatBytes(srate, sizeof(srate), rate);
+	if (!total)
+		return snprintf(text, size, "%s, %s/s", sdone, srate);
+	if (rate <= 0.0 || done >= total)
+		return snprintf(text, size, "%s/%s, %s/s", sdone, stotal, srate);
+
+	uint64_t eta = (uint64_t)((double)(total - done) / rate);
+	return snprintf(text, size, "%s/%s, %s/s, ETA %u:%02u:%02u", sdone, stotal, srate, (uint)(eta / 3600), (uint)(eta / 60 % 60), (uint)(eta % 60));
+}
+
+static void* consoleProgressProc(Process* prc) {
+	char text[PROGRESS_TEXT_MAX];
+	g_mutex_lock(&prc->progressMutex);
+	while (!prc->progressStop) {
+		formatProgress(prc, text, sizeof(text));
+		g_printerr("\r%-*s", PROGRESS_TEXT_MAX - 1, text);
+		g_cond_wait_until(&prc->progressCond, &prc->progressMutex, g_get_monotonic_time() + PROGRESS_INTERVAL * G_TIME_SPAN_MILLISECOND);
+	}
+	g_mutex_unlock(&prc->progressMutex);
+	formatProgress(prc, text, sizeof(text));
+	g_printerr("\r%-*s\n", PROGRESS_TEXT_MAX - 1, text);
+	return NULL;
+}
+
+void startConsoleProgress(Process* prc) {
+	g_mutex_init(&prc->progressMutex);
+	g_cond_init(&prc->progressCond);
+	prc->progressStop = false;
+	prc->progressThread = g_thread_new(NULL, (GThreadFunc)consoleProgressProc, prc);
+}
+
+void stopConsoleProgress(Process* prc) {
+	if (!prc->progressThread)
+		return;
+
+	g_mutex_lock(&prc->progressMutex);
+	prc->progressStop = true;
+	g_cond_signal(&prc->progressCond);
+	g_mutex_unlock(&prc->progressMutex);
+	g_thread_join(prc->progressThread);
+	prc->progressThread = NULL;
+	g_cond_clear(&prc->progressCond);
+	g_mutex_clear(&prc->progressMutex);
+}
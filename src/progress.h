@@ -0,0 +1,16 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include "utils.h"
+
+#define PROGRESS_TEXT_MAX 64
+#define PROGRESS_INTERVAL 500
+
+uint64_t measureFile(const char* path);
+void initProgress(Process* prc, uint64_t total);
+double progressFraction(const Process* prc);
+int formatProgress(const Process* prc, char* text, size_t size);
+void startConsoleProgress(Process* prc);
+void stopConsoleProgress(Process* prc);
+
+#endif
@@ -1,18 +1,52 @@
+#include "applier.h"
 #include "arguments.h"
+#include "checkpoint.h"
+#include "collision.h"
+#include "copy.h"
+#include "durable.h"
+#include "input.h"
+#include "journal.h"
+#include "output.h"
+#include "pipeline.h"
+#include "plan.h"
+#include "policy.h"
+#include "preflight.h"
+#include "progress.h"
 #include "rename.h"
+#include "retry.h"
+#include "rules.h"
+#include "throttle.h"
+#include "verify.h"
 #include "window.h"
-#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #ifdef _WIN32
 #include <shlwapi.h>
-#else
-#include <sys/sendfile.h>
 #endif
 
 #define CONTINUE_TEXT "\nContinue?"
 
+typedef struct ConsolePipe {
+	Input* in;
+	const RuleSet* rules;
+	Process** workers;
+	size_t nWorkers;
+	size_t id;
+	int8_t step;
+} ConsolePipe;
+
+typedef struct ConsoleApply {
+	Process* prc;
+	Process** shards;
+	size_t nShards;
+} ConsoleApply;
+
+typedef struct ConsoleRetry {
+	Process* prc;
+	Process* rp;
+} ConsoleRetry;
+
 #ifndef CONSOLE
 typedef struct TableUpdate {
 	Window* win;
@@ -21,109 +55,11 @@ typedef struct TableUpdate {
 } TableUpdate;
 #endif
 
-#ifdef _WIN32
-static int createSymlink(const char* target, const char* path) {
-	wchar_t* wpath = stow(path);
-	wchar_t* wtarget = stow(target);
-	DWORD attr = GetFileAttributesW(wtarget);
-	DWORD flags = attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) ? SYMBOLIC_LINK_FLAG_DIRECTORY : 0;
-	int rc = !CreateSymbolicLinkW(wpath, wtarget, flags);
-	free(wpath);
-	free(wtarget);
-	return rc;
-}
-#endif
-
-static char* joinPath(const char* dir, size_t dlen, const char* file, size_t flen) {
-	char* path = malloc((dlen + flen + 2) * sizeof(char));
-	memcpy(path, dir, dlen * sizeof(char));
-	path[dlen] = '/';
-	memcpy(path + dlen + 1, file, (flen + 1) * sizeof(char));
-	return path;
+static int moveFile(Process* prc, const char* src, const char* dst) {
+	return rename(src, dst);
 }
 
-static int copyFile(const char* src, const char* dst) {
-	struct stat ps;
-#ifdef _WIN32
-	if (stat(src, &ps))
-#else
-	if (lstat(src, &ps))
-#endif
-		return -1;
-
-	int rc;
-	switch (ps.st_mode & S_IFMT) {
-	case S_IFDIR: {
-#ifdef _WIN32
-		mkdir(dst);
-#else
-		mkdir(dst, ps.st_mode & ~S_IFMT);
-#endif
-		DIR* dir = opendir(src);
-		if (!dir)
-			return -1;
-
-		rc = 0;
-		size_t slen = strlen(src);
-		size_t dlen = strlen(dst);
-		for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir))
-			if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
-				size_t nlen = strlen(entry->d_name);
-				char* from = joinPath(src, slen, entry->d_name, nlen);
-				char* to = joinPath(dst, dlen, entry->d_name, nlen);
-				rc |= copyFile(from, to);
-				free(from);
-				free(to);
-			}
-		closedir(dir);
-		break; }
-	case S_IFREG: {
-#ifdef _WIN32
-		wchar_t* wsrc = stow(src);
-		wchar_t* wdst = stow(dst);
-		rc = !CopyFileW(wsrc, wdst, false);
-		free(wsrc);
-		free(wdst);
-#else
-		int in = open(src, O_RDONLY);
-		if (in == -1)
-			return -1;
-
-		int out = creat(dst, ps.st_mode & ~S_IFMT);
-		if (out == -1) {
-			close(in);
-			return -1;
-		}
-		rc = sendfile(out, in, NULL, ps.st_size) != -1 ? 0 : errno;
-		close(in);
-		close(out);
-#endif
-		break; }
-#ifndef _WIN32
-	case S_IFLNK: {
-		rc = -1;
-		char* path = malloc((ps.st_size + 1) * sizeof(char));
-		ssize_t len = readlink(src, path, ps.st_size);
-		if (len != -1) {
-			path[len] = '\0';
-			rc = symlink(path, dst);
-		}
-		free(path);
-		break; }
-#endif
-	default:
-#ifdef _WIN32
-		rc = createSymlink(src, dst);
-#else
-		rc = symlink(src, dst);
-#endif
-	}
-	return rc;
-}
-
-static ResponseType continueError(Process* prc, Window* win, const char* format, ...) {
-	va_list args;
-	va_start(args, format);
+static ResponseType continueErrorV(Process* prc, Window* win, const char* format, va_list args) {
 	ResponseType rc = RESPONSE_NONE;
 	if (prc->messageBehavior == MSGBEHAVIOR_ASK && (prc->forward ? prc->id < prc->total - 1 : prc->id)) {
 		size_t flen = strlen(format);
@@ -148,6 +84,61 @@ static ResponseType continueError(Process* prc, Window* win, const char* format,
 			rc = RESPONSE_YES;
 		}
 	}
+	return rc;
+}
+
+static ResponseType continueError(Process* prc, Window* win, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	ResponseType rc = continueErrorV(prc, win, format, args);
+	va_end(args);
+	return rc;
+}
+
+static void lockErrors(Process* prc) {
+	if (prc->errorMutex)
+		g_mutex_lock(prc->errorMutex);
+}
+
+static void unlockErrors(Process* prc) {
+	if (prc->errorMutex)
+		g_mutex_unlock(prc->errorMutex);
+}
+
+// an error in making a name has no system call behind it, so it gets the code that describes it best for the policy
+static ResponseType failName(Process* prc, int err, Window* win, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	ResponseType rc;
+	if (prc->deferErrors) {
+		// a pipeline worker leaves the decision to the main thread, which gets to the file in order
+		prc->deferredMessage = g_strdup_vprintf(format, args);
+		prc->deferredError = err;
+		rc = RESPONSE_WAIT;
+	} else {
+		// a name can't be tried again and there's nothing in the way to remove yet
+		ErrorAction act = errorAction(prc->errorPolicy, err);
+		if (act == ERROR_RETRY || act == ERROR_OVERWRITE)
+			act = exhaustedAction(prc->errorPolicy);
+		lockErrors(prc);
+		switch (act) {
+		case ERROR_SKIP:
+			rc = RESPONSE_YES;
+			break;
+		case ERROR_COLLECT:
+			collectError(prc->errors, prc->original, prc->name, err);
+			rc = RESPONSE_YES;
+			break;
+		case ERROR_ABORT:
+			if (!win)
+				showMessageV(win, MESSAGE_ERROR, BUTTONS_OK, format, args);
+			rc = RESPONSE_NO;
+			break;
+		default:
+			rc = continueErrorV(prc, win, format, args);
+		}
+		unlockErrors(prc);
+	}
 	va_end(args);
 	return rc;
 }
@@ -227,7 +218,7 @@ static ResponseType nameRename(Process* prc, Window* win) {
 	}
 
 	if (prc->nameLen >= FILENAME_MAX)
-		return continueError(prc, win, "Filename became too long during rename.");
+		return failName(prc, ENAMETOOLONG, win, "Filename became too long during rename.");
 	return RESPONSE_NONE;
 }
 
@@ -286,7 +277,7 @@ static void nameRemove(Process* prc) {
 static ResponseType nameAdd(Process* prc, Window* win) {
 	if (prc->addInsertLen) {
 		if (prc->nameLen + prc->addInsertLen >= FILENAME_MAX)
-			return continueError(prc, win, "Filename '%s' became too long during add.", prc->name);
+			return failName(prc, ENAMETOOLONG, win, "Filename '%s' became too long during add.", prc->name);
 
 		char* pos = getUtf8Offset(prc->name, prc->nameLen, prc->addAt, g_utf8_strlen(prc->name, prc->nameLen));
 		memmove(pos + prc->addInsertLen, pos, (size_t)(prc->name + prc->nameLen - pos + 1) * sizeof(char));
@@ -296,7 +287,7 @@ static ResponseType nameAdd(Process* prc, Window* win) {
 
 	if (prc->addPrefixLen) {
 		if (prc->nameLen + prc->addPrefixLen >= FILENAME_MAX)
-			return continueError(prc, win, "Filename '%s' became too long during add.", prc->name);
+			return failName(prc, ENAMETOOLONG, win, "Filename '%s' became too long during add.", prc->name);
 
 		memmove(prc->name + prc->addPrefixLen, prc->name, (prc->nameLen + 1) * sizeof(char));
 		memcpy(prc->name, prc->addPrefix, prc->addPrefixLen * sizeof(char));
@@ -305,7 +296,7 @@ static ResponseType nameAdd(Process* prc, Window* win) {
 
 	if (prc->addSuffixLen) {
 		if (prc->nameLen + prc->addSuffixLen >= FILENAME_MAX)
-			return continueError(prc, win, "Filename '%s' became too long during add.", prc->name);
+			return failName(prc, ENAMETOOLONG, win, "Filename '%s' became too long during add.", prc->name);
 
 		memcpy(prc->name + prc->nameLen, prc->addSuffix, (prc->addSuffixLen + 1) * sizeof(char));
 		prc->nameLen += prc->addSuffixLen;
@@ -321,7 +312,7 @@ static ResponseType nameNumber(Process* prc, Window* win) {
 	size_t padLeft = blen < prc->numberPadding && prc->numberPadStrLen ? (prc->numberPadding - blen) * prc->numberPadStrLen : 0;
 	size_t pbslen = prc->numberPrefixLen + negative + padLeft + blen + prc->numberSuffixLen;
 	if (prc->nameLen + pbslen >= FILENAME_MAX)
-		return continueError(prc, win, "Filename '%s' became too long while adding number.", prc->name);
+		return failName(prc, ENAMETOOLONG, win, "Filename '%s' became too long while adding number.", prc->name);
 
 	char* pos = getUtf8Offset(prc->name, prc->nameLen, prc->numberLocation, g_utf8_strlen(prc->name, prc->nameLen));
 	memmove(pos + pbslen, pos, (size_t)(prc->name + prc->nameLen - pos + 1) * sizeof(char));
@@ -337,17 +328,13 @@ static ResponseType nameNumber(Process* prc, Window* win) {
 	return RESPONSE_NONE;
 }
 
-static ResponseType nameDate(Process* prc, Window* win) {
-	if (prc->dateMode == DATE_NONE)
-		return RESPONSE_NONE;
-
-	GDateTime* date;
+static ResponseType readFileDate(Process* prc, Window* win, GDateTime** date) {
 #ifdef _WIN32
 	wchar_t* path = stow(prc->original);
 	HANDLE fh = CreateFileW(path, FILE_READ_ATTRIBUTES | STANDARD_RIGHTS_READ | SYNCHRONIZE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 	free(path);
 	if (fh == INVALID_HANDLE_VALUE)
-		return continueError(prc, win, "Failed to retrieve file info");
+		return failName(prc, EIO, win, "Failed to retrieve file info");
 
 	FILETIME ft, lf;
 	SYSTEMTIME st;
@@ -365,35 +352,51 @@ static ResponseType nameDate(Process* prc, Window* win) {
 	ok = ok && FileTimeToLocalFileTime(&ft, &lf) && FileTimeToSystemTime(&lf, &st);
 	CloseHandle(fh);
 	if (!ok)
-		return continueError(prc, win, "Failed to retrieve file info");
-	date = g_date_time_new_local(st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+		return failName(prc, EIO, win, "Failed to retrieve file info");
+	*date = g_date_time_new_local(st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
 #else
 	struct statx ps;
 	if (statx(-1, prc->original, AT_SYMLINK_NOFOLLOW | AT_STATX_SYNC_AS_STAT, prc->statMask, &ps))
-		return continueError(prc, win, "Failed to retrieve file info: %s", strerror(errno));
+		return failName(prc, errno, win, "Failed to retrieve file info: %s", g_strerror(errno));
 
 	switch (prc->dateMode) {
 	case DATE_CREATE:
-		date = g_date_time_new_from_unix_local(ps.stx_btime.tv_sec);
+		*date = g_date_time_new_from_unix_local(ps.stx_btime.tv_sec);
 		break;
 	case DATE_MODIFY:
-		date = g_date_time_new_from_unix_local(ps.stx_mtime.tv_sec);
+		*date = g_date_time_new_from_unix_local(ps.stx_mtime.tv_sec);
 		break;
 	case DATE_ACCESS:
-		date = g_date_time_new_from_unix_local(ps.stx_atime.tv_sec);
+		*date = g_date_time_new_from_unix_local(ps.stx_atime.tv_sec);
 		break;
 	case DATE_CHANGE:
-		date = g_date_time_new_from_unix_local(ps.stx_ctime.tv_sec);
+		*date = g_date_time_new_from_unix_local(ps.stx_ctime.tv_sec);
 	}
 #endif
+	return RESPONSE_NONE;
+}
+
+static ResponseType nameDate(Process* prc, Window* win) {
+	if (prc->dateMode == DATE_NONE)
+		return RESPONSE_NONE;
+
+	GDateTime* date;
+	if (prc->meta && (prc->dateMode == DATE_MODIFY || prc->dateMode == DATE_CHANGE))
+		date = g_date_time_new_from_unix_local(prc->dateMode == DATE_MODIFY ? prc->meta->mtime : prc->meta->ctime);
+	else {
+		ResponseType rc = readFileDate(prc, win, &date);
+		if (rc != RESPONSE_NONE)
+			return rc;
+	}
+
 	char* dstr = g_date_time_format(date, prc->dateFormat);
 	g_date_time_unref(date);
 	if (!dstr)
-		return continueError(prc, win, "Failed to format date for file '%s'.", prc->name);
+		return failName(prc, EINVAL, win, "Failed to format date for file '%s'.", prc->name);
 	size_t dlen = strlen(dstr);
 	if (prc->nameLen + dlen >= FILENAME_MAX) {
 		g_free(dstr);
-		return continueError(prc, win, "Filename '%s' became too long while adding date.", prc->name);
+		return failName(prc, ENAMETOOLONG, win, "Filename '%s' became too long while adding date.", prc->name);
 	}
 
 	char* pos = getUtf8Offset(prc->name, prc->nameLen, prc->dateLocation, g_utf8_strlen(prc->name, prc->nameLen));
@@ -458,7 +461,7 @@ static size_t processExtension(Process* prc, const char* str, size_t slen) {
 static ResponseType processName(Process* prc, const char* oldn, size_t olen, Window* win) {
 	size_t elen = processExtension(prc, oldn, olen);
 	if (elen >= FILENAME_MAX)
-		return continueError(prc, win, "Extension became too long.");
+		return failName(prc, ENAMETOOLONG, win, "Extension became too long.");
 
 	ResponseType rc = nameRename(prc, win);
 	if (rc != RESPONSE_NONE)
@@ -477,7 +480,7 @@ static ResponseType processName(Process* prc, const char* oldn, size_t olen, Win
 		return rc;
 
 	if (prc->nameLen + elen >= FILENAME_MAX)
-		return continueError(prc, win, "Filename '%s' became too long while reapplying extension.", prc->name);
+		return failName(prc, ENAMETOOLONG, win, "Filename '%s' became too long while reapplying extension.", prc->name);
 	memcpy(prc->name + prc->nameLen, prc->extension, (elen + 1) * sizeof(char));
 	prc->nameLen += elen;
 	return rc;
@@ -632,6 +635,10 @@ static bool initWindowRename(Window* win) {
 	prc->numberBase = gtk_spin_button_get_value_as_int(win->sbNumberBase);
 	prc->numberDigits = pickDigitChars(prc->numberBase, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(win->cbNumberUpper)));
 	prc->forward = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(win->cbDestinationForward));
+	prc->verify = win->args->verify;
+	prc->durable = win->args->durable || win->args->syncEvery || win->args->syncfs;
+	prc->syncfs = win->args->syncfs;
+	prc->syncEvery = win->args->syncEvery;
 	prc->total = gtk_tree_model_iter_n_children(prc->model, NULL);
 	prc->id = prc->forward ? 0 : prc->total - 1;
 	prc->step = prc->forward ? 1 : -1;
@@ -648,9 +655,12 @@ static bool initWindowRename(Window* win) {
 }
 #endif
 
-static bool initConsoleRename(Process* prc, const Arguments* arg, GFile** files, size_t nFiles) {
-	if (!files)
+static bool initConsoleRename(Process* prc, const Arguments* arg, const Input* in) {
+	// a streamed input only has its next entry, so it can't be gone through from the end
+	if (arg->backwards && inputStreamed(in)) {
+		showMessage(NULL, MESSAGE_ERROR, BUTTONS_OK, "--backwards can't be combined with --files-from or --recursive");
 		return false;
+	}
 	prc->extensionName = arg->extensionName ? arg->extensionName : "";
 	prc->extensionReplace = arg->extensionReplace ? arg->extensionReplace : "";
 	prc->rename = arg->rename ? arg->rename : "";
@@ -664,7 +674,12 @@ static bool initConsoleRename(Process* prc, const Arguments* arg, GFile** files,
 	prc->dateFormat = arg->dateFormat ? arg->dateFormat : DEFAULT_DATE_FORMAT;
 	prc->destination = arg->destination ? arg->destination : "";
 	prc->forward = !arg->backwards;
-	prc->total = nFiles;
+	prc->verify = arg->verify;
+	prc->durable = arg->durable || arg->syncEvery || arg->syncfs;
+	prc->syncfs = arg->syncfs;
+	prc->syncEvery = arg->syncEvery;
+	prc->total = inputStreamed(in) ? 0 : in->nPaths;
+	prc->meta = in->hasMeta ? &in->meta : NULL;
 	prc->id = prc->forward ? 0 : prc->total - 1;
 	prc->step = prc->forward ? 1 : -1;
 	prc->numberStart = arg->numberStart;
@@ -673,6 +688,7 @@ static bool initConsoleRename(Process* prc, const Arguments* arg, GFile** files,
 	prc->renameMode = arg->renameMode;
 	prc->dateMode = arg->dateMode;
 	prc->destinationMode = arg->destinationMode;
+	prc->collisionMode = arg->collisionMode;
 	prc->extensionNameLen = strlen(prc->extensionName);
 	prc->extensionReplaceLen = strlen(prc->extensionReplace);
 	prc->extensionElements = arg->extensionElements;
@@ -706,6 +722,53 @@ static bool initConsoleRename(Process* prc, const Arguments* arg, GFile** files,
 	return initRename(prc, NULL);
 }
 
+static void initErrorPolicy(Process* prc, const Arguments* arg) {
+	prc->errorPolicy = arg->errorPolicy.used ? &arg->errorPolicy : NULL;
+	prc->errors = prc->errorPolicy ? newErrorReport() : NULL;
+}
+
+static void initThrottles(Process* prc, const Arguments* arg) {
+	prc->opsLimit = newThrottle(arg->maxOpsPerSec);
+	prc->bytesLimit = newThrottle(arg->maxBytesPerSec);
+}
+
+static void freeThrottles(Process* prc) {
+	freeThrottle(prc->opsLimit);
+	freeThrottle(prc->bytesLimit);
+	prc->opsLimit = NULL;
+	prc->bytesLimit = NULL;
+}
+
+static void freeConsoleRules(RuleSet* rs) {
+	for (size_t i = 0; i < rs->count; ++i)
+		if (rs->rules[i].proc) {
+			freeRegexes(rs->rules[i].proc);
+			free(rs->rules[i].proc);
+		}
+	freeRules(rs);
+}
+
+static bool initConsoleRules(Process* prc, const Arguments* arg, const Input* in, RuleSet* rs) {
+	if (!loadRules(rs, arg->rules, NULL))
+		return false;
+
+	for (size_t i = 0; i < rs->count; ++i) {
+		Process* rp = calloc(1, sizeof(Process));
+		rp->messageBehavior = prc->messageBehavior;
+		if (!initConsoleRename(rp, &rs->rules[i].args, in)) {
+			free(rp);
+			freeConsoleRules(rs);
+			return false;
+		}
+		// every rule set numbers its files separately in the order they come in
+		rp->forward = true;
+		rp->id = 0;
+		rp->step = 1;
+		rs->rules[i].proc = rp;
+	}
+	return true;
+}
+
 #ifndef CONSOLE
 void setProgressBar(GtkProgressBar* bar, size_t pos, size_t total, bool fwd) {
 	if (!fwd)
@@ -716,22 +779,68 @@ void setProgressBar(GtkProgressBar* bar, size_t pos, size_t total, bool fwd) {
 	gtk_progress_bar_set_text(bar, text);
 }
 
-static void setOriginalNameWindow(Process* prc, char** name, size_t* nameLen, char** dirc, size_t* dircLen) {
+static void setOriginalNameWindow(Window* win, char** name, size_t* nameLen, char** dirc, size_t* dircLen) {
+	Process* prc = win->proc;
 	gtk_tree_model_get(prc->model, &prc->it, FCOL_OLD_NAME, name, FCOL_DIRECTORY, dirc, FCOL_INVALID);
 	*nameLen = strlen(*name);
 	*dircLen = strlen(*dirc);
 	memcpy(prc->original, *dirc, *dircLen * sizeof(char));
 	memcpy(prc->original + *dircLen, *name, (*nameLen + 1) * sizeof(char));
+	prc->meta = g_hash_table_lookup(win->fileMeta, prc->original);
 }
 #endif
 
-static void setOriginalNameConsole(Process* prc, GFile** files, size_t* plen) {
-	const char* path = g_file_peek_path(files[prc->id]);
-	*plen = strlen(path);
-	memcpy(prc->original, path, (*plen + 1) * sizeof(char));
-#ifdef _WIN32
-	unbackslashify(prc->original);
-#endif
+static size_t setOriginalNameConsole(Process* prc, const char* path, size_t plen) {
+	memcpy(prc->original, path, (plen + 1) * sizeof(char));
+	// arguments are used as they were typed, so a directory may come with trailing slashes
+	for (; plen > 1 && prc->original[plen - 1] == '/'; --plen)
+		prc->original[plen - 1] = '\0';
+	return plen;
+}
+
+static const char* setOriginalDestinationConsole(Process* prc, const char* path, size_t plen, size_t* olen) {
+	plen = setOriginalNameConsole(prc, path, plen);
+	const char* oldn = memrchr(prc->original, '/', plen * sizeof(char));
+	if (oldn) {
+		++oldn;
+		if (prc->destinationMode == DESTINATION_IN_PLACE) {
+			prc->dstdirLen = oldn - prc->original;
+			memcpy(prc->dstdir, prc->original, prc->dstdirLen * sizeof(char));
+			prc->dstdir[prc->dstdirLen] = '\0';
+		}
+	} else {
+		if (prc->destinationMode == DESTINATION_IN_PLACE) {
+			prc->dstdirLen = 0;
+			prc->dstdir[0] = '\0';
+		}
+		oldn = prc->original;
+	}
+	*olen = prc->original + plen - oldn;
+	return oldn;
+}
+
+// a rule set only makes the new name, whereas the file is applied with the options of the run
+static ResponseType processConsoleName(Process* prc, const RuleSet* rs, const char* oldn, size_t olen, size_t* matched) {
+	Rule* rule = rs->count ? matchRule(rs, prc->original, oldn, prc->meta) : NULL;
+	if (matched)
+		*matched = rule ? (size_t)(rule - rs->rules) + 1 : 0;
+	if (!rule)
+		return processName(prc, oldn, olen, NULL);
+
+	Process* rp = rule->proc;
+	size_t dlen = oldn - prc->original;
+	memcpy(rp->original, prc->original, (dlen + olen + 1) * sizeof(char));
+	ResponseType rc = processName(rp, rp->original + dlen, olen, NULL);
+	rp->id += rp->step;
+	if (rc == RESPONSE_NONE) {
+		memcpy(prc->name, rp->name, (rp->nameLen + 1) * sizeof(char));
+		prc->nameLen = rp->nameLen;
+	} else if (rc == RESPONSE_WAIT) {
+		prc->deferredMessage = rp->deferredMessage;
+		prc->deferredError = rp->deferredError;
+		rp->deferredMessage = NULL;
+	}
+	return rc;
 }
 
 static bool initDestination(Process* prc, Window* win) {
@@ -758,29 +867,238 @@ static bool initDestination(Process* prc, Window* win) {
 	memcpy(prc->dstdir, prc->destination, (prc->destinationLen + 1) * sizeof(char));
 	if (extend)
 		strcpy(prc->dstdir + prc->destinationLen, "/");
+	if (prc->destinationMode == DESTINATION_COPY || prc->destinationMode == DESTINATION_HARDLINK)
+		initCopy(prc);
 	return true;
 }
 
-static ResponseType processFile(Process* prc, const char* oldn, size_t olen, Window* win) {
+// renames between the last checkpoint and an interruption may have been applied already
+static bool isApplied(Process* prc) {
 	if (prc->dstdirLen + prc->nameLen >= PATH_MAX)
-		return continueError(prc, win, "Path '%s%s' is too long.", prc->dstdir, prc->name);
+		return false;
 
+	struct stat ps;
 	memcpy(prc->dstdir + prc->dstdirLen, prc->name, (prc->nameLen + 1) * sizeof(char));
+	if (stat(prc->dstdir, &ps))
+		return false;
+	return (prc->destinationMode != DESTINATION_IN_PLACE && prc->destinationMode != DESTINATION_MOVE) || stat(prc->original, &ps);
+}
+
+static int (*const applyFuncs[5])(Process*, const char*, const char*) = { moveFile, moveFile, copyFile, symlinkFile, linkFile };
+
+static void reportFile(Process* prc, const char* src, const char* dst) {
+	if (prc->reportNames) {
+		const char* sep = strrchr(src, '/');
+		if (sep)
+			src = sep + 1;
+		if ((sep = strrchr(dst, '/')))
+			dst = sep + 1;
+	}
+	writeOutput(prc->output, src, dst);
+}
+
+// a file is only reported once it's done, which may be on an apply shard or the retry thread
+static void recordFile(Process* prc, const char* src, const char* dst, Window* win) {
+	lockErrors(prc);
+	if (prc->journal)
+		writeJournal(prc, src, dst);
+	if (prc->durable)
+		markApplied(prc, src, dst, win);
+	if (prc->output)
+		reportFile(prc, src, dst);
+	unlockErrors(prc);
+}
+
+static ResponseType failFile(Process* prc, const char* src, const char* dst, int err, ErrorAction act, Window* win) {
+	ResponseType rc;
+	switch (act) {
+	case ERROR_SKIP:
+		return RESPONSE_YES;
+	case ERROR_COLLECT:
+		lockErrors(prc);
+		collectError(prc->errors, src, dst, err);
+		unlockErrors(prc);
+		return RESPONSE_YES;
+	case ERROR_ABORT:
+		lockErrors(prc);
+		if (!win)
+			showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to rename '%s' to '%s':\n%s", src, dst, g_strerror(err));
+		unlockErrors(prc);
+		return RESPONSE_NO;
+	default:
+		lockErrors(prc);
+		rc = continueError(prc, win, "Failed to rename '%s' to '%s':\n%s", src, dst, g_strerror(err));
+		unlockErrors(prc);
+		return rc;
+	}
+}
+
+// an error with a policy is decided without asking, whereas one without a policy or whose retries are used up is handled like any other
+static ResponseType runFile(Process* prc, const char* src, const char* dst, Window* win) {
+	if (prc->retries)
+		waitRetries(prc->retries, src, dst);
+	int (*func)(Process*, const char*, const char*) = applyFuncs[prc->destinationMode];
+	for (uint tries = 0;; ++tries) {
+		throttle(prc->opsLimit, 1);
+		if (!func(prc, src, dst))
+			return RESPONSE_NONE;
+
+		int err = errno;
+		ErrorAction act = errorAction(prc->errorPolicy, err);
+		if (act == ERROR_RETRY) {
+			// copies share the table of copied inodes with the main thread, so they wait for their retries in place
+			if (prc->retries && prc->destinationMode != DESTINATION_COPY && prc->destinationMode != DESTINATION_HARDLINK) {
+				queueRetry(prc->retries, src, dst, prc->destinationMode);
+				return RESPONSE_YES;
+			}
+			if (tries < prc->retryLimit) {
+				g_usleep(retryDelay(tries));
+				continue;
+			}
+			act = exhaustedAction(prc->errorPolicy);
+		} else if (act == ERROR_OVERWRITE && !tries && (err == EEXIST || err == ENOTEMPTY) && !remove(dst))
+			continue;
+		return failFile(prc, src, dst, err, act, win);
+	}
+}
+
+static ResponseType applyFile(Process* prc, Window* win) {
+	ResponseType rc = runFile(prc, prc->original, prc->dstdir, win);
+	if (rc == RESPONSE_NONE)
+		recordFile(prc, prc->original, prc->dstdir, win);
+	return rc;
+}
+
+// a name that has been given out already or belongs to an existing file is skipped or gets a number, so that nothing gets overwritten
+static ResponseType resolveCollision(Process* prc, const char* oldn, size_t olen, Window* win) {
+	if (!prc->names)
+		return RESPONSE_NONE;
+
+	size_t nlen = claimName(prc->names, prc->dstdir, prc->dstdirLen, prc->name, prc->nameLen, prc->destinationMode == DESTINATION_IN_PLACE ? oldn : NULL, olen, prc->collisionMode);
+	if (!nlen)
+		return RESPONSE_YES;
+	if (nlen == SIZE_MAX)
+		return failName(prc, EEXIST, win, "Name '%s' can't be made unique.", prc->name);
+	prc->nameLen = nlen;
+	return RESPONSE_NONE;
+}
+
+static int statIdentity(const char* path, struct stat* ps) {
 #ifdef _WIN32
-	int rc = (int (*const[4])(const char*, const char*)){ rename, rename, copyFile, createSymlink }[prc->destinationMode](prc->original, prc->dstdir);
+	return stat(path, ps);
 #else
-	int rc = (int (*const[4])(const char*, const char*)){ rename, rename, copyFile, symlink }[prc->destinationMode](prc->original, prc->dstdir);
+	return lstat(path, ps);
 #endif
-	return rc ? continueError(prc, win, "Failed to rename '%s' to '%s':\n%s", prc->original, prc->dstdir, strerror(errno)) : RESPONSE_NONE;
+}
+
+struct SourceIndex {
+	GHashTable* paths;
+	char* dstdir;
+	size_t dstdirLen;
+};
+
+// the listed paths have been resolved already, so only a destination directory that's given separately needs the same treatment
+static SourceIndex* newSourceIndex(const Process* prc, char** paths, size_t count) {
+	SourceIndex* si = malloc(sizeof(SourceIndex));
+	si->paths = g_hash_table_new(g_str_hash, g_str_equal);
+	for (size_t i = 0; i < count; ++i)
+		g_hash_table_insert(si->paths, paths[i], paths[i]);
+	si->dstdir = NULL;
+	si->dstdirLen = 0;
+	if (prc->destinationMode == DESTINATION_MOVE) {
+		char* cwd = workingDirectory();
+		si->dstdir = malloc((strlen(cwd) + prc->destinationLen + 2) * sizeof(char));
+		si->dstdirLen = resolvePath(si->dstdir, cwd, prc->destination) - si->dstdir;
+		g_free(cwd);
+	}
+	return si;
+}
+
+static void freeSourceIndex(SourceIndex* si) {
+	if (si) {
+		g_hash_table_destroy(si->paths);
+		free(si->dstdir);
+		free(si);
+	}
+}
+
+// a name that still belongs to another listed file would overwrite that file before it gets its own new name, so chains and swaps are left to a plan, which orders them
+static bool takenBySource(const Process* prc) {
+	const SourceIndex* si = prc->sources;
+	char path[PATH_MAX + 1];
+	const char* dst = prc->dstdir;
+	if (si->dstdir) {
+		// the listed paths are shorter than PATH_MAX, so a longer one can't be among them
+		if (si->dstdirLen + prc->nameLen >= PATH_MAX)
+			return false;
+		resolvePath(path, si->dstdir, prc->name);
+		dst = path;
+	}
+
+	struct stat ps;
+	return strcmp(dst, prc->original) && g_hash_table_contains(si->paths, dst) && !statIdentity(dst, &ps);
+}
+
+static ResponseType processFile(Process* prc, Applier* ap, const char* oldn, size_t olen, Window* win) {
+	ResponseType rc = resolveCollision(prc, oldn, olen, win);
+	if (rc != RESPONSE_NONE)
+		return rc;
+	if (prc->dstdirLen + prc->nameLen >= PATH_MAX)
+		return failName(prc, ENAMETOOLONG, win, "Path '%s%s' is too long.", prc->dstdir, prc->name);
+
+	memcpy(prc->dstdir + prc->dstdirLen, prc->name, (prc->nameLen + 1) * sizeof(char));
+	if (prc->sources && takenBySource(prc))
+		return failName(prc, EEXIST, win, "'%s' is still to be renamed and won't be replaced by '%s', use --plan-out to rename chains and swaps.", prc->dstdir, prc->original);
+	if (!ap) {
+		rc = applyFile(prc, win);
+		// a file that's renamed later can only take the old name once it's certain to be free, which queued renames aren't
+		if (rc == RESPONSE_NONE && prc->names && (prc->destinationMode == DESTINATION_IN_PLACE || prc->destinationMode == DESTINATION_MOVE))
+			releaseName(prc->names, prc->original, oldn - prc->original, oldn);
+		return rc;
+	}
+	queueApply(ap, prc->id, prc->original, oldn - prc->original + olen, prc->dstdir, prc->dstdirLen + prc->nameLen);
+	return applierFailed(ap) ? RESPONSE_NO : RESPONSE_NONE;
+}
+
+static ResponseType planFile(Process* prc, const char* oldn, size_t olen) {
+	ResponseType rc = resolveCollision(prc, oldn, olen, NULL);
+	if (rc != RESPONSE_NONE)
+		return rc;
+	if (prc->dstdirLen + prc->nameLen >= PATH_MAX)
+		return failName(prc, ENAMETOOLONG, NULL, "Path '%s%s' is too long.", prc->dstdir, prc->name);
+
+	struct stat ps;
+	if (statIdentity(prc->original, &ps))
+		return failName(prc, errno, NULL, "Failed to identify '%s':\n%s", prc->original, g_strerror(errno));
+	memcpy(prc->dstdir + prc->dstdirLen, prc->name, (prc->nameLen + 1) * sizeof(char));
+	writePlan(prc, ps.st_dev, ps.st_ino);
+	return RESPONSE_NONE;
 }
 
 #ifndef CONSOLE
+static void setCopyProgressBar(GtkProgressBar* bar, const Process* prc) {
+	size_t pos = prc->forward ? prc->id : prc->total - prc->id - 1;
+	char text[MAX_DIGITS_I32D * 2 + 4 + PROGRESS_TEXT_MAX];
+	int len = snprintf(text, sizeof(text) / sizeof(*text), "%zu/%zu, ", pos, prc->total);
+	formatProgress(prc, text + len, sizeof(text) / sizeof(*text) - len);
+	gtk_progress_bar_set_fraction(bar, progressFraction(prc));
+	gtk_progress_bar_set_text(bar, text);
+}
+
 gboolean updateProgressBar(Window* win) {
 	Process* prc = win->proc;
-	setProgressBar(win->pbRename, prc->id, prc->total, prc->forward);
+	if (win->threadCode == THREAD_RENAME && prc->destinationMode == DESTINATION_COPY)
+		setCopyProgressBar(win->pbRename, prc);
+	else
+		setProgressBar(win->pbRename, prc->id, prc->total, prc->forward);
 	return G_SOURCE_REMOVE;
 }
 
+static gboolean tickProgressBar(Window* win) {
+	updateProgressBar(win);
+	return G_SOURCE_CONTINUE;
+}
+
 static gboolean updateTableNames(TableUpdate* tu) {
 	gtk_list_store_set(tu->win->lsFiles, &tu->iter, FCOL_OLD_NAME, tu->name, FCOL_INVALID);
 	free(tu);
@@ -788,21 +1106,51 @@ static gboolean updateTableNames(TableUpdate* tu) {
 }
 
 static gboolean finishWindowRenameProc(Window* win) {
+	if (win->proc->progressTimer) {
+		g_source_remove(win->proc->progressTimer);
+		win->proc->progressTimer = 0;
+	}
 	finishThread(win);
+	if (win->staleMeta) {
+		for (guint i = 0; i < win->staleMeta->len; ++i)
+			g_hash_table_remove(win->fileMeta, win->staleMeta->pdata[i]);
+		g_ptr_array_free(win->staleMeta, TRUE);
+		win->staleMeta = NULL;
+	}
 	freeRegexes(win->proc);
+	finishCopy(win->proc, win);
+	closeJournal(win->proc, win);
 	setWidgetsSensitive(win, true);
 	autoPreview(win);
 	return G_SOURCE_REMOVE;
 }
 
+static void measureWindowFiles(Process* prc) {
+	uint64_t total = 0;
+	GtkTreeIter it;
+	for (gboolean valid = gtk_tree_model_get_iter_first(prc->model, &it); valid; valid = gtk_tree_model_iter_next(prc->model, &it)) {
+		char* name;
+		char* dirc;
+		gtk_tree_model_get(prc->model, &it, FCOL_OLD_NAME, &name, FCOL_DIRECTORY, &dirc, FCOL_INVALID);
+		char* path = g_strconcat(dirc, name, NULL);
+		total += measureFile(path);
+		g_free(path);
+		g_free(name);
+		g_free(dirc);
+	}
+	atomic_store_explicit(&prc->bytesTotal, total, memory_order_relaxed);
+}
+
 static void* windowRenameProc(Window* win) {
 	Process* prc = win->proc;
 	ResponseType rc;
 	char* oldName;
 	char* oldDirc;
 	size_t oldNameLen, oldDircLen;
+	if (prc->destinationMode == DESTINATION_COPY)
+		measureWindowFiles(prc);
 	do {
-		setOriginalNameWindow(prc, &oldName, &oldNameLen, &oldDirc, &oldDircLen);
+		setOriginalNameWindow(win, &oldName, &oldNameLen, &oldDirc, &oldDircLen);
 		rc = processName(prc, oldName, oldNameLen, win);
 		if (rc == RESPONSE_NONE) {
 			if (prc->destinationMode == DESTINATION_IN_PLACE) {
@@ -810,8 +1158,14 @@ static void* windowRenameProc(Window* win) {
 				memcpy(prc->dstdir, oldDirc, (oldDircLen + 1) * sizeof(char));
 			}
 
-			rc = processFile(prc, oldName, oldNameLen, win);
+			rc = processFile(prc, NULL, oldName, oldNameLen, win);
 			if (rc == RESPONSE_NONE) {
+				// the row is moved to the new file, which the listed values don't describe, but the table is only changed once this thread is done looking things up in it
+				if (prc->meta) {
+					if (!win->staleMeta)
+						win->staleMeta = g_ptr_array_new_with_free_func(g_free);
+					g_ptr_array_add(win->staleMeta, g_strdup(prc->original));
+				}
 				TableUpdate* tu = malloc(sizeof(TableUpdate));
 				tu->win = win;
 				tu->iter = prc->it;
@@ -834,7 +1188,16 @@ void windowRename(Window* win) {
 		return;
 	if (!initDestination(prc, win))
 		return;
+	if (win->args->journal && !openJournal(prc, win->args->journal, win)) {
+		freeRegexes(prc);
+		finishCopy(prc, win);
+		return;
+	}
 	setWidgetsSensitive(win, false);
+	if (prc->destinationMode == DESTINATION_COPY) {
+		initProgress(prc, 0);
+		prc->progressTimer = g_timeout_add(PROGRESS_INTERVAL, G_SOURCE_FUNC(tickProgressBar), win);
+	}
 	runThread(win, THREAD_RENAME, (GThreadFunc)windowRenameProc, (gboolean (*)(void*))finishWindowRenameProc, win);
 }
 
@@ -848,7 +1211,7 @@ void windowPreview(Window* win) {
 	char* oldDirc;
 	size_t oldNameLen, oldDircLen;
 	do {
-		setOriginalNameWindow(prc, &oldName, &oldNameLen, &oldDirc, &oldDircLen);
+		setOriginalNameWindow(win, &oldName, &oldNameLen, &oldDirc, &oldDircLen);
 		rc = processName(prc, oldName, oldNameLen, win);
 		if (rc == RESPONSE_NONE)
 			gtk_list_store_set(win->lsFiles, &prc->it, FCOL_NEW_NAME, prc->name, FCOL_INVALID);
@@ -860,66 +1223,573 @@ void windowPreview(Window* win) {
 }
 #endif
 
-void consoleRename(Process* prc, const Arguments* arg, GFile** files, size_t nFiles) {
-	if (!initConsoleRename(prc, arg, files, nFiles))
+static bool ingestConsoleFile(ConsolePipe* cp, PipeItem* it) {
+	const char* path = nextInput(cp->in, cp->id, &it->plen);
+	if (!path)
+		return false;
+
+	memcpy(it->original, path, (it->plen + 1) * sizeof(char));
+	if (cp->in->hasMeta)
+		it->meta = cp->in->meta;
+	it->id = cp->id;
+	cp->id += cp->step;
+	return true;
+}
+
+static void computeConsoleName(ConsolePipe* cp, size_t worker, PipeItem* it) {
+	Process* wp = cp->workers[worker];
+	size_t olen;
+	wp->id = it->id;
+	wp->meta = cp->in->hasMeta ? &it->meta : NULL;
+	const char* oldn = setOriginalDestinationConsole(wp, it->original, it->plen, &olen);
+	it->rc = processConsoleName(wp, cp->rules, oldn, olen, &it->rule);
+	if (it->rc == RESPONSE_NONE) {
+		it->nameLen = wp->nameLen;
+		memcpy(it->name, wp->name, (wp->nameLen + 1) * sizeof(char));
+	} else if (it->rc == RESPONSE_WAIT) {
+		it->message = wp->deferredMessage;
+		it->error = wp->deferredError;
+		wp->deferredMessage = NULL;
+	}
+}
+
+static Pipeline* startConsolePipe(ConsolePipe* cp, Process* prc, const Arguments* arg, Input* in, const RuleSet* rs) {
+	cp->in = in;
+	cp->rules = rs;
+	// the rule sets count their own files, so they can only be used by one worker
+	cp->nWorkers = rs->count ? 1 : (size_t)arg->computeThreads;
+	cp->workers = malloc(cp->nWorkers * sizeof(Process*));
+	cp->id = prc->id;
+	cp->step = prc->step;
+	for (size_t i = 0; i < cp->nWorkers; ++i) {
+		// a worker only uses the naming part of its copy, whose regexes can be shared
+		cp->workers[i] = memcpy(malloc(sizeof(Process)), prc, sizeof(Process));
+		cp->workers[i]->deferErrors = true;
+	}
+	for (size_t i = 0; i < rs->count; ++i)
+		if (rs->rules[i].proc)
+			rs->rules[i].proc->deferErrors = true;
+	return startPipeline(cp->nWorkers, (PipeIngest)ingestConsoleFile, (PipeCompute)computeConsoleName, cp);
+}
+
+static void stopConsolePipe(ConsolePipe* cp, Pipeline* pl) {
+	cancelInput(cp->in);
+	stopPipeline(pl);
+	for (size_t i = 0; i < cp->nWorkers; ++i)
+		free(cp->workers[i]);
+	free(cp->workers);
+}
+
+// the file system call runs unlocked, whereas the journal, the synced directories and the prompts are shared by all shards
+static bool applyShardFile(ConsoleApply* ca, size_t shard, const ApplyOp* op) {
+	Process* sp = ca->shards[shard];
+	sp->id = op->id;
+	ResponseType rc = runFile(sp, op->src, op->dst, NULL);
+	if (rc == RESPONSE_NONE)
+		recordFile(ca->prc, op->src, op->dst, NULL);
+	return rc == RESPONSE_NONE || rc == RESPONSE_YES;
+}
+
+static Applier* startConsoleApply(ConsoleApply* ca, Process* prc, const Arguments* arg) {
+	ca->prc = prc;
+	ca->nShards = arg->applyThreads;
+	ca->shards = malloc(ca->nShards * sizeof(Process*));
+	for (size_t i = 0; i < ca->nShards; ++i)
+		ca->shards[i] = memcpy(malloc(sizeof(Process)), prc, sizeof(Process));
+	return startApplier(ca->nShards, (ApplyFunc)applyShardFile, ca);
+}
+
+static bool stopConsoleApply(ConsoleApply* ca, Applier* ap) {
+	bool ok = stopApplier(ap);
+	for (size_t i = 0; i < ca->nShards; ++i)
+		free(ca->shards[i]);
+	free(ca->shards);
+	return ok;
+}
+
+static int retryConsoleFile(ConsoleRetry* cr, const char* src, const char* dst, int mode) {
+	throttle(cr->rp->opsLimit, 1);
+	return applyFuncs[mode](cr->rp, src, dst) ? errno : 0;
+}
+
+static bool finishConsoleRetry(ConsoleRetry* cr, const char* src, const char* dst, int mode, int err) {
+	if (!err) {
+		recordFile(cr->prc, src, dst, NULL);
+		return true;
+	}
+	ResponseType rc = failFile(cr->rp, src, dst, err, exhaustedAction(cr->rp->errorPolicy), NULL);
+	return rc == RESPONSE_NONE || rc == RESPONSE_YES;
+}
+
+// the retries run on their own thread, so that a file that's busy for a while doesn't hold up the others
+static void startConsoleRetries(ConsoleRetry* cr, Process* prc, const Arguments* arg, GMutex* mutex) {
+	g_mutex_init(mutex);
+	prc->errorMutex = mutex;
+	prc->retryLimit = arg->retryLimit;
+	cr->prc = prc;
+	cr->rp = memcpy(malloc(sizeof(Process)), prc, sizeof(Process));
+	prc->retries = arg->retryLimit ? startRetries(arg->retryLimit, (RetryAttempt)retryConsoleFile, (RetryFinish)finishConsoleRetry, cr) : NULL;
+}
+
+static bool stopConsoleRetries(ConsoleRetry* cr, Process* prc) {
+	bool ok = !prc->retries || stopRetries(prc->retries);
+	prc->retries = NULL;
+	g_mutex_clear(prc->errorMutex);
+	prc->errorMutex = NULL;
+	free(cr->rp);
+	return ok;
+}
+
+// every name is made up front to check the targets, whereas naming errors are left to the run, which starts the numbering over
+static bool preflightConsole(Process* prc, const RuleSet* rs, Input* in) {
+	size_t start = prc->id;
+	size_t* ruleIds = malloc(rs->count * sizeof(size_t));
+	for (size_t i = 0; i < rs->count; ++i) {
+		ruleIds[i] = rs->rules[i].proc->id;
+		rs->rules[i].proc->deferErrors = true;
+	}
+	prc->deferErrors = true;
+	prc->names = prc->collisionMode != COLLISION_OVERWRITE ? newNameIndex() : NULL;
+
+	PlanEntry* entries = malloc(in->nPaths * sizeof(PlanEntry));
+	size_t count = 0;
+	const char* path;
+	size_t plen;
+	for (; (path = nextInput(in, prc->id, &plen)); prc->id += prc->step) {
+		size_t olen;
+		const char* oldn = setOriginalDestinationConsole(prc, path, plen, &olen);
+		ResponseType rc = processConsoleName(prc, rs, oldn, olen, NULL);
+		if (rc == RESPONSE_NONE)
+			rc = resolveCollision(prc, oldn, olen, NULL);
+		if (rc == RESPONSE_WAIT) {
+			g_free(prc->deferredMessage);
+			prc->deferredMessage = NULL;
+		}
+		if (rc != RESPONSE_NONE || prc->dstdirLen + prc->nameLen >= PATH_MAX)
+			continue;
+
+		memcpy(prc->dstdir + prc->dstdirLen, prc->name, (prc->nameLen + 1) * sizeof(char));
+		struct stat ps;
+		uint64_t dev = prc->destinationMode == DESTINATION_HARDLINK && !statIdentity(prc->original, &ps) ? (uint64_t)ps.st_dev : 0;
+		entries[count++] = (PlanEntry){ g_strdup(prc->original), g_strdup(prc->dstdir), dev, 0, prc->destinationMode };
+	}
+
+	freeNameIndex(prc->names);
+	prc->names = NULL;
+	prc->deferErrors = false;
+	prc->id = start;
+	for (size_t i = 0; i < rs->count; ++i) {
+		rs->rules[i].proc->id = ruleIds[i];
+		rs->rules[i].proc->deferErrors = false;
+	}
+	free(ruleIds);
+
+	bool ok = preflightPlan(entries, count, false, NULL);
+	for (size_t i = 0; i < count; ++i) {
+		g_free((char*)entries[i].src);
+		g_free((char*)entries[i].dst);
+	}
+	free(entries);
+	return ok;
+}
+
+void consoleRename(Process* prc, const Arguments* arg, char** paths, size_t nPaths) {
+	Input in;
+	RuleSet rules;
+	// a walk lists the entries that have been renamed already in another order, so a saved position would point at the wrong entry
+	if (arg->checkpoint && arg->recursive && (!arg->destination || arg->destinationMode == DESTINATION_IN_PLACE || arg->destinationMode == DESTINATION_MOVE)) {
+		showMessage(NULL, MESSAGE_ERROR, BUTTONS_OK, "--checkpoint can't be combined with --recursive when files are renamed in place or moved");
 		return;
-	if (!initDestination(prc, NULL))
+	}
+	if (!openInput(&in, arg, paths, nPaths, NULL) || !initConsoleRules(prc, arg, &in, &rules)) {
+		closeInput(&in);
+		return;
+	}
+	if (!initConsoleRename(prc, arg, &in) || !initDestination(prc, NULL)) {
+		freeConsoleRules(&rules);
+		closeInput(&in);
 		return;
+	}
 
-	ResponseType rc;
+	size_t unsure = 0;
+	uint64_t inputHash = 0;
+	// every rule set's numbering goes with the position, counting only the files that are done
+	uint64_t* ruleIds = calloc(rules.count, sizeof(uint64_t));
+	uint64_t* drainedIds = calloc(rules.count, sizeof(uint64_t));
+	// a streamed list can't be hashed in advance, so only the entries that are done are hashed as they come
+	HashState listHash, drainedHash;
+	hashInit(&listHash);
+	if (arg->checkpoint) {
+		inputHash = in.buf ? hashDigest(&listHash) : hashInputFiles(in.paths, in.nPaths);
+		if (arg->resume) {
+			if (!loadCheckpoint(prc, arg->checkpoint, &inputHash, !in.buf, ruleIds, rules.count)) {
+				free(ruleIds);
+				free(drainedIds);
+				freeRegexes(prc);
+				finishCopy(prc, NULL);
+				freeConsoleRules(&rules);
+				closeInput(&in);
+				return;
+			}
+			for (size_t i = 0; i < rules.count; ++i)
+				rules.rules[i].proc->id = drainedIds[i] = ruleIds[i];
+			size_t plen;
+			const char* skipped;
+			for (size_t i = 0; inputStreamed(&in) && i < prc->id && (skipped = nextInput(&in, i, &plen)); ++i)
+				if (in.buf)
+					hashUpdate(&listHash, skipped, plen + 1);
+			if (in.buf && hashDigest(&listHash) != inputHash) {
+				showMessage(NULL, MESSAGE_ERROR, BUTTONS_OK, "Checkpoint '%s' was made for a different file list", arg->checkpoint);
+				free(ruleIds);
+				free(drainedIds);
+				freeRegexes(prc);
+				finishCopy(prc, NULL);
+				freeConsoleRules(&rules);
+				closeInput(&in);
+				return;
+			}
+			unsure = CHECKPOINT_INTERVAL;
+		}
+		catchInterrupts();
+	}
+	if ((!inputStreamed(&in) && !preflightConsole(prc, &rules, &in)) || (arg->journal && !openJournal(prc, arg->journal, NULL))) {
+		free(ruleIds);
+		free(drainedIds);
+		freeRegexes(prc);
+		finishCopy(prc, NULL);
+		freeConsoleRules(&rules);
+		closeInput(&in);
+		return;
+	}
+	if (arg->progress && prc->destinationMode == DESTINATION_COPY) {
+		uint64_t total = 0;
+		for (size_t i = 0; i < in.nPaths; ++i)
+			total += measureFile(in.paths[i]);
+		initProgress(prc, total);
+		startConsoleProgress(prc);
+	}
+
+	Output out;
+	if (arg->verbose)
+		openOutput(&out, arg->outputFormat);
+	prc->output = arg->verbose ? &out : NULL;
+	prc->reportNames = prc->destinationMode == DESTINATION_IN_PLACE;
+	ConsolePipe cp;
+	Pipeline* pl = arg->computeThreads ? startConsolePipe(&cp, prc, arg, &in, &rules) : NULL;
+	prc->names = arg->collisionMode != COLLISION_OVERWRITE ? newNameIndex() : NULL;
+	prc->sources = !inputStreamed(&in) && (prc->destinationMode == DESTINATION_IN_PLACE || prc->destinationMode == DESTINATION_MOVE) ? newSourceIndex(prc, in.paths, in.nPaths) : NULL;
+	initErrorPolicy(prc, arg);
+	initThrottles(prc, arg);
+	GMutex mutex;
+	ConsoleRetry cr;
+	startConsoleRetries(&cr, prc, arg, &mutex);
+	ConsoleApply ca;
+	// copies share the table of copied inodes and hard links can fall back to copying, so they're applied in turn
+	Applier* ap = arg->applyThreads && prc->destinationMode != DESTINATION_COPY && prc->destinationMode != DESTINATION_HARDLINK ? startConsoleApply(&ca, prc, arg) : NULL;
+	ResponseType rc = RESPONSE_NONE;
+	size_t pending = 0;
+	size_t drained = prc->id;
+	drainedHash = listHash;
+	PipeItem* it = NULL;
+	const char* path;
 	size_t plen;
-	do {
-		setOriginalNameConsole(prc, files, &plen);
-		const char* oldn = memrchr(prc->original, '/', plen * sizeof(char));
-		if (oldn) {
-			++oldn;
-			if (prc->destinationMode == DESTINATION_IN_PLACE) {
-				prc->dstdirLen = oldn - prc->original;
-				memcpy(prc->dstdir, prc->original, prc->dstdirLen * sizeof(char));
-				prc->dstdir[prc->dstdirLen] = '\0';
+	while ((rc == RESPONSE_NONE || rc == RESPONSE_YES) && !interruptCaught() && (pl ? (it = nextPipeItem(pl)) != NULL : (path = nextInput(&in, prc->id, &plen)) != NULL)) {
+		size_t olen;
+		size_t matched;
+		const char* oldn;
+		if (it) {
+			// the name has already been made by a worker
+			prc->id = it->id;
+			matched = it->rule;
+			prc->meta = in.hasMeta ? &it->meta : NULL;
+			oldn = setOriginalDestinationConsole(prc, it->original, it->plen, &olen);
+			rc = it->rc;
+			if (rc == RESPONSE_NONE) {
+				prc->nameLen = it->nameLen;
+				memcpy(prc->name, it->name, (it->nameLen + 1) * sizeof(char));
+			} else if (rc == RESPONSE_WAIT) {
+				rc = failName(prc, it->error, NULL, "%s", it->message);
+				g_free(it->message);
+				it->message = NULL;
 			}
 		} else {
-			if (prc->destinationMode == DESTINATION_IN_PLACE) {
-				prc->dstdirLen = 0;
-				prc->dstdir[0] = '\0';
+			oldn = setOriginalDestinationConsole(prc, path, plen, &olen);
+			rc = processConsoleName(prc, &rules, oldn, olen, &matched);
+		}
+		if (unsure) {
+			--unsure;
+			if (rc == RESPONSE_NONE && isApplied(prc))
+				rc = RESPONSE_YES;
+		}
+		if (rc == RESPONSE_NONE)
+			rc = processFile(prc, ap, oldn, olen, NULL);
+		// the file that stopped the run is tried again on resume
+		if (rc == RESPONSE_NONE || rc == RESPONSE_YES) {
+			prc->id += prc->step;
+			if (matched)
+				++ruleIds[matched - 1];
+			if (in.buf && arg->checkpoint)
+				hashUpdate(&listHash, it ? it->original : path, (it ? it->plen : plen) + 1);
+		}
+		if (prc->retries && retriesFailed(prc->retries))
+			rc = RESPONSE_NO;
+		if (arg->checkpoint && ++pending == CHECKPOINT_INTERVAL) {
+			// a checkpoint may only cover renames that are done
+			if (ap && !drainApplier(ap))
+				rc = RESPONSE_NO;
+			if (prc->retries && !drainRetries(prc->retries))
+				rc = RESPONSE_NO;
+			if (in.buf)
+				inputHash = hashDigest(&listHash);
+			// going on without a checkpoint would leave more renames behind the saved position than a resume can recognize
+			if (!saveCheckpoint(prc, arg->checkpoint, inputHash, ruleIds, rules.count))
+				rc = RESPONSE_NO;
+			drained = prc->id;
+			drainedHash = listHash;
+			memcpy(drainedIds, ruleIds, rules.count * sizeof(uint64_t));
+			pending = 0;
+		}
+	}
+	if (pl)
+		stopConsolePipe(&cp, pl);
+	freeNameIndex(prc->names);
+	prc->names = NULL;
+	freeSourceIndex(prc->sources);
+	prc->sources = NULL;
+	bool queued = ap || prc->retries;
+	if (ap && !stopConsoleApply(&ca, ap) && (rc == RESPONSE_NONE || rc == RESPONSE_YES))
+		rc = RESPONSE_NO;
+	if (!stopConsoleRetries(&cr, prc) && (rc == RESPONSE_NONE || rc == RESPONSE_YES))
+		rc = RESPONSE_NO;
+	// the files queued after the last checkpoint are checked again on resume
+	if (queued && arg->checkpoint && ((rc != RESPONSE_NONE && rc != RESPONSE_YES) || interruptCaught())) {
+		prc->id = drained;
+		listHash = drainedHash;
+		memcpy(ruleIds, drainedIds, rules.count * sizeof(uint64_t));
+	}
+	finishErrorReport(prc->errors, arg->errorReport);
+	prc->errors = NULL;
+	if (arg->verbose)
+		closeOutput(&out);
+	prc->output = NULL;
+	if (arg->checkpoint) {
+		if (in.buf)
+			inputHash = hashDigest(&listHash);
+		bool saved = true;
+		if ((rc != RESPONSE_NONE && rc != RESPONSE_YES) || interruptCaught())
+			saved = saveCheckpoint(prc, arg->checkpoint, inputHash, ruleIds, rules.count);
+		else
+			remove(arg->checkpoint);
+		if (interruptCaught())
+			g_printerr(saved ? "Interrupted, run again with --resume to continue\n" : "Interrupted, but the checkpoint couldn't be saved\n");
+	}
+	stopConsoleProgress(prc);
+	free(ruleIds);
+	free(drainedIds);
+	freeRegexes(prc);
+	finishCopy(prc, NULL);
+	freeThrottles(prc);
+	closeJournal(prc, NULL);
+	freeConsoleRules(&rules);
+	closeInput(&in);
+}
+
+void consoleUndo(Process* prc, const Arguments* arg) {
+	GMappedFile* map;
+	size_t count;
+	JournalEntry* entries = loadJournal(arg->undo, &map, &count, NULL);
+	if (!entries)
+		return;
+
+	prc->total = count;
+	prc->forward = false;
+	Output out;
+	openOutput(&out, arg->outputFormat);
+	ResponseType rc = RESPONSE_NONE;
+	for (size_t i = count; i && (rc == RESPONSE_NONE || rc == RESPONSE_YES); --i) {
+		prc->id = i - 1;
+		const JournalEntry* it = &entries[prc->id];
+		bool move = it->mode == DESTINATION_IN_PLACE || it->mode == DESTINATION_MOVE;
+		if (!arg->dry) {
+			if ((int (*const[5])(Process*, const char*, const char*)){ moveFile, moveFile, removeCopy, removeLink, removeCopy }[it->mode](prc, it->dst, it->src)) {
+				rc = continueError(prc, NULL, "Failed to undo '%s' -> '%s':\n%s", it->src, it->dst, strerror(errno));
+				continue;
 			}
-			oldn = prc->original;
+			if (!arg->verbose)
+				continue;
 		}
-		size_t olen = prc->original + plen - oldn;
+		writeOutput(&out, it->dst, move ? it->src : NULL);
+	}
+	closeOutput(&out);
+	free(entries);
+	g_mapped_file_unref(map);
+}
+
+void consolePlan(Process* prc, const Arguments* arg, char** paths, size_t nPaths) {
+	Input in;
+	RuleSet rules;
+	if (!openInput(&in, arg, paths, nPaths, NULL) || !initConsoleRules(prc, arg, &in, &rules)) {
+		closeInput(&in);
+		return;
+	}
+	if (!initConsoleRename(prc, arg, &in) || !initDestination(prc, NULL)) {
+		freeConsoleRules(&rules);
+		closeInput(&in);
+		return;
+	}
+	if (!openPlan(prc, arg->planOut, NULL)) {
+		freeRegexes(prc);
+		finishCopy(prc, NULL);
+		freeConsoleRules(&rules);
+		closeInput(&in);
+		return;
+	}
 
-		rc = processName(prc, oldn, olen, NULL);
+	Output out;
+	if (arg->verbose)
+		openOutput(&out, arg->outputFormat);
+	prc->names = arg->collisionMode != COLLISION_OVERWRITE ? newNameIndex() : NULL;
+	ResponseType rc = RESPONSE_NONE;
+	const char* path;
+	size_t plen;
+	while ((rc == RESPONSE_NONE || rc == RESPONSE_YES) && (path = nextInput(&in, prc->id, &plen))) {
+		size_t olen;
+		const char* oldn = setOriginalDestinationConsole(prc, path, plen, &olen);
+		rc = processConsoleName(prc, &rules, oldn, olen, NULL);
 		if (rc == RESPONSE_NONE) {
-			rc = processFile(prc, oldn, olen, NULL);
-			if (rc == RESPONSE_NONE && arg->verbose) {
-				if (prc->destinationMode == DESTINATION_IN_PLACE)
-					g_print("'%s' -> '%s'\n", oldn, prc->name);
-				else
-					g_print("'%s' -> '%s%s'\n", prc->original, prc->dstdir, prc->name);
-			}
+			rc = planFile(prc, oldn, olen);
+			if (rc == RESPONSE_NONE && arg->verbose)
+				writeOutput(&out, prc->original, prc->dstdir);
 		}
 		prc->id += prc->step;
-	} while ((rc == RESPONSE_NONE || rc == RESPONSE_YES) && prc->id < nFiles);
+	}
+	freeNameIndex(prc->names);
+	prc->names = NULL;
+	if (arg->verbose)
+		closeOutput(&out);
 	freeRegexes(prc);
+	finishCopy(prc, NULL);
+	closePlan(prc, arg->planOut, NULL);
+	freeConsoleRules(&rules);
+	closeInput(&in);
 }
 
-void consolePreview(Process* prc, const Arguments* arg, GFile** files, size_t nFiles) {
-	if (!initConsoleRename(prc, arg, files, nFiles))
+void consoleApplyPlan(Process* prc, const Arguments* arg) {
+	GMappedFile* map;
+	size_t count;
+	PlanEntry* entries = loadPlan(arg->planIn, &map, &count, NULL);
+	if (!entries)
 		return;
+	GPtrArray* parking = reparkPlan(entries, count);
+
+	// every identity is checked before anything is applied, so a stale plan doesn't leave a half done rename behind
+	bool copies = false;
+	GHashTable* moved = g_hash_table_new(g_str_hash, g_str_equal);
+	for (size_t i = 0; i < count; ++i) {
+		// a file parked under a temporary name by an earlier entry has to be that entry's file
+		const PlanEntry* from = g_hash_table_lookup(moved, entries[i].src);
+		struct stat ps;
+		if (from) {
+			ps.st_dev = from->dev;
+			ps.st_ino = from->ino;
+		}
+		if ((!from && statIdentity(entries[i].src, &ps)) || (uint64_t)ps.st_dev != entries[i].dev || (uint64_t)ps.st_ino != entries[i].ino || strlen(entries[i].src) >= PATH_MAX || strlen(entries[i].dst) >= PATH_MAX) {
+			showMessage(NULL, MESSAGE_ERROR, BUTTONS_OK, "Plan '%s' is stale, '%s' has changed since it was made", arg->planIn, entries[i].src);
+			g_hash_table_destroy(moved);
+			g_ptr_array_free(parking, TRUE);
+			free(entries);
+			g_mapped_file_unref(map);
+			return;
+		}
+		if (entries[i].mode == DESTINATION_IN_PLACE || entries[i].mode == DESTINATION_MOVE)
+			g_hash_table_insert(moved, (char*)entries[i].dst, &entries[i]);
+		copies |= entries[i].mode == DESTINATION_COPY || entries[i].mode == DESTINATION_HARDLINK;
+	}
+	g_hash_table_destroy(moved);
+	if (!preflightPlan(entries, count, true, NULL)) {
+		g_ptr_array_free(parking, TRUE);
+		free(entries);
+		g_mapped_file_unref(map);
+		return;
+	}
 
-	ResponseType rc;
+	prc->total = count;
+	prc->forward = true;
+	prc->step = 1;
+	prc->verify = arg->verify;
+	prc->durable = arg->durable || arg->syncEvery || arg->syncfs;
+	prc->syncfs = arg->syncfs;
+	prc->syncEvery = arg->syncEvery;
+	if (copies)
+		initCopy(prc);
+	initErrorPolicy(prc, arg);
+	initThrottles(prc, arg);
+	GMutex mutex;
+	ConsoleRetry cr;
+	startConsoleRetries(&cr, prc, arg, &mutex);
+	Output out;
+	if (arg->verbose)
+		openOutput(&out, arg->outputFormat);
+	prc->output = arg->verbose ? &out : NULL;
+	if (!arg->journal || openJournal(prc, arg->journal, NULL)) {
+		ResponseType rc = RESPONSE_NONE;
+		for (prc->id = 0; prc->id < count && (rc == RESPONSE_NONE || rc == RESPONSE_YES); ++prc->id) {
+			const PlanEntry* it = &entries[prc->id];
+			strcpy(prc->original, it->src);
+			strcpy(prc->dstdir, it->dst);
+			prc->destinationMode = it->mode;
+			rc = applyFile(prc, NULL);
+			if (prc->retries && retriesFailed(prc->retries))
+				rc = RESPONSE_NO;
+		}
+	}
+	stopConsoleRetries(&cr, prc);
+	if (arg->verbose)
+		closeOutput(&out);
+	prc->output = NULL;
+	finishErrorReport(prc->errors, arg->errorReport);
+	prc->errors = NULL;
+	finishCopy(prc, NULL);
+	freeThrottles(prc);
+	closeJournal(prc, NULL);
+	g_ptr_array_free(parking, TRUE);
+	free(entries);
+	g_mapped_file_unref(map);
+}
+
+void consolePreview(Process* prc, const Arguments* arg, char** paths, size_t nPaths) {
+	Input in;
+	RuleSet rules;
+	if (!openInput(&in, arg, paths, nPaths, NULL) || !initConsoleRules(prc, arg, &in, &rules)) {
+		closeInput(&in);
+		return;
+	}
+	if (!initConsoleRename(prc, arg, &in)) {
+		freeConsoleRules(&rules);
+		closeInput(&in);
+		return;
+	}
+
+	Output out;
+	openOutput(&out, arg->outputFormat);
+	ResponseType rc = RESPONSE_NONE;
+	const char* path;
 	size_t olen;
-	do {
-		setOriginalNameConsole(prc, files, &olen);
+	while ((rc == RESPONSE_NONE || rc == RESPONSE_YES) && (path = nextInput(&in, prc->id, &olen))) {
+		olen = setOriginalNameConsole(prc, path, olen);
 		const char* oldn = memrchr(prc->original, '/', olen * sizeof(char));
 		if (oldn)
 			olen = prc->original + olen - ++oldn;
 		else
 			oldn = prc->original;
 
-		rc = processName(prc, oldn, olen, NULL);
+		rc = processConsoleName(prc, &rules, oldn, olen, NULL);
 		if (rc == RESPONSE_NONE)
-			g_print("'%s' -> '%s'\n", oldn, prc->name);
+			writeOutput(&out, oldn, prc->name);
 		prc->id += prc->step;
-	} while ((rc == RESPONSE_NONE || rc == RESPONSE_YES) && prc->id < nFiles);
+	}
+	closeOutput(&out);
 	freeRegexes(prc);
+	freeConsoleRules(&rules);
+	closeInput(&in);
 }
@@ -2,6 +2,7 @@
 #define RENAME_H
 
 #include "utils.h"
+#include <stdatomic.h>
 
 #define MAX_DIGITS_I32D 10
 
@@ -15,6 +16,7 @@ typedef struct Process {
 #ifndef CONSOLE
 	GtkTreeModel* model;
 	GtkTreeIter it;
+	guint progressTimer;
 #endif
 	size_t id;
 	size_t total;
@@ -33,11 +35,42 @@ typedef struct Process {
 	const char* numberSuffix;
 	const char* dateFormat;
 	const char* destination;
+	const FileMeta* meta;
 	size_t nameLen;
 	size_t dstdirLen;
+	size_t syncEvery;
+	size_t unsynced;
+	uint retryLimit;
 	int64_t numberStart;
 	int64_t numberStep;
+	FILE* journal;
+	char* workDir;
+	Plan* plan;
+	NameIndex* names;
+	SourceIndex* sources;
+	const ErrorPolicy* errorPolicy;
+	ErrorReport* errors;
+	GMutex* errorMutex;
+	char* deferredMessage;
+	int deferredError;
+	Output* output;
+	RetryQueue* retries;
+	Throttle* opsLimit;
+	Throttle* bytesLimit;
+	GThread* progressThread;
+	GMutex progressMutex;
+	GCond progressCond;
+	atomic_uint_least64_t bytesDone;
+	atomic_uint_least64_t bytesTotal;
+	gint64 progressStart;
+	GThreadPool* verifyPool;
+	GPtrArray* verifyFails;
+	GMutex verifyMutex;
 #ifndef _WIN32
+	GHashTable* copiedInodes;
+	GHashTable* dirtyDirs;
+	const char* lastDirty;
+	size_t lastDirtyLen;
 	uint statMask;
 #endif
 	MessageBehavior messageBehavior;
@@ -45,6 +78,7 @@ typedef struct Process {
 	RenameMode renameMode;
 	DateMode dateMode;
 	DestinationMode destinationMode;
+	CollisionMode collisionMode;
 	ushort extensionNameLen;
 	ushort extensionReplaceLen;
 	short extensionElements;
@@ -73,6 +107,12 @@ typedef struct Process {
 	bool number;
 	uint8_t numberBase;
 	bool forward;
+	bool verify;
+	bool progressStop;
+	bool durable;
+	bool syncfs;
+	bool deferErrors;
+	bool reportNames;
 	int8_t step;
 	char name[FILENAME_MAX];
 	char extension[FILENAME_MAX];
@@ -86,6 +126,9 @@ gboolean updateProgressBar(Window* win);
 void windowRename(Window* win);
 void windowPreview(Window* win);
 #endif
-void consoleRename(Process* prc, const Arguments* arg, GFile** files, size_t nFiles);
-void consolePreview(Process* prc, const Arguments* arg, GFile** files, size_t nFiles);
+void consoleRename(Process* prc, const Arguments* arg, char** paths, size_t nPaths);
+void consolePreview(Process* prc, const Arguments* arg, char** paths, size_t nPaths);
+void consolePlan(Process* prc, const Arguments* arg, char** paths, size_t nPaths);
+void consoleApplyPlan(Process* prc, const Arguments* arg);
+void consoleUndo(Process* prc, const Arguments* arg);
 #endif
@@ -0,0 +1,222 @@
+#include "retry.h"
+#include <stdatomic.h>
+
+#define RETRY_DELAY_BASE (100 * 1000)
+#define RETRY_DELAY_MAX (10 * G_USEC_PER_SEC)
+
+typedef struct RetryItem {
+	gint64 due;
+	uint attempts;
+	int mode;
+	char* dst;
+	char src[];
+} RetryItem;
+
+struct RetryQueue {
+	RetryItem** heap;
+	size_t count;
+	size_t lim;
+	size_t active;
+	GHashTable* busy;
+	GHashTable* waiting;
+	GThread* thread;
+	RetryAttempt attempt;
+	RetryFinish finish;
+	void* data;
+	GMutex mutex;
+	GCond cond;
+	uint limit;
+	bool stop;
+	atomic_bool failed;
+};
+
+// the delay doubles with every attempt and is spread by half of it either way, so that files held by the same lock don't all come back at once
+gint64 retryDelay(uint attempts) {
+	gint64 delay = MIN((gint64)RETRY_DELAY_BASE << MIN(attempts, 16), RETRY_DELAY_MAX);
+	return delay / 2 + g_random_int_range(0, (gint32)delay);
+}
+
+static void pushItem(RetryQueue* rq, RetryItem* it) {
+	if (rq->count == rq->lim) {
+		rq->lim *= 2;
+		rq->heap = realloc(rq->heap, rq->lim * sizeof(RetryItem*));
+	}
+
+	size_t pos = rq->count++;
+	for (size_t up; pos && rq->heap[up = (pos - 1) / 2]->due > it->due; pos = up)
+		rq->heap[pos] = rq->heap[up];
+	rq->heap[pos] = it;
+}
+
+static RetryItem* popItem(RetryQueue* rq) {
+	RetryItem* top = rq->heap[0];
+	RetryItem* last = rq->heap[--rq->count];
+	size_t pos = 0;
+	for (size_t down; (down = pos * 2 + 1) < rq->count; pos = down) {
+		if (down + 1 < rq->count && rq->heap[down + 1]->due < rq->heap[down]->due)
+			++down;
+		if (rq->heap[down]->due >= last->due)
+			break;
+		rq->heap[pos] = rq->heap[down];
+	}
+	if (rq->count)
+		rq->heap[pos] = last;
+	return top;
+}
+
+static void countPath(GHashTable* paths, const char* path, size_t len, bool add) {
+	char* key = g_strndup(path, len);
+	size_t cnt = GPOINTER_TO_SIZE(g_hash_table_lookup(paths, key));
+	if (add)
+		g_hash_table_replace(paths, key, GSIZE_TO_POINTER(cnt + 1));
+	else {
+		if (cnt > 1)
+			g_hash_table_replace(paths, key, GSIZE_TO_POINTER(cnt - 1));
+		else {
+			g_hash_table_remove(paths, key);
+			g_free(key);
+		}
+	}
+}
+
+// a path counts as busy along with all of its parent directories, so that no directory is moved from under a waiting file
+static void markBusy(RetryQueue* rq, const char* path, bool add) {
+	size_t len = strlen(path);
+	countPath(rq->waiting, path, len, add);
+	for (; len; len = len ? len - 1 : 0) {
+		countPath(rq->busy, path, len, add);
+		for (; len && path[len - 1] != '/'; --len);
+	}
+}
+
+// a waiting path may be a directory, which would take everything inside it along
+static bool insideWaiting(GHashTable* waiting, const char* path) {
+	char* dir = g_strdup(path);
+	bool found = false;
+	for (char* sep = strrchr(dir, '/'); sep && !found; sep = strrchr(dir, '/')) {
+		*sep = '\0';
+		found = g_hash_table_contains(waiting, dir);
+	}
+	g_free(dir);
+	return found;
+}
+
+static void releaseItem(RetryQueue* rq, RetryItem* it) {
+	markBusy(rq, it->src, false);
+	markBusy(rq, it->dst, false);
+	free(it);
+	--rq->active;
+	g_cond_broadcast(&rq->cond);
+}
+
+// the files wait in a heap ordered by when they're due, so that a file that keeps failing doesn't hold up any other
+static void* retryProc(RetryQueue* rq) {
+	g_mutex_lock(&rq->mutex);
+	while (!rq->stop || rq->count) {
+		if (!rq->count) {
+			g_cond_wait(&rq->cond, &rq->mutex);
+			continue;
+		}
+		if (rq->heap[0]->due > g_get_monotonic_time() && !atomic_load_explicit(&rq->failed, memory_order_relaxed)) {
+			g_cond_wait_until(&rq->cond, &rq->mutex, rq->heap[0]->due);
+			continue;
+		}
+
+		RetryItem* it = popItem(rq);
+		if (atomic_load_explicit(&rq->failed, memory_order_relaxed)) {
+			releaseItem(rq, it);
+			continue;
+		}
+		g_mutex_unlock(&rq->mutex);
+		int err = rq->attempt(rq->data, it->src, it->dst, it->mode);
+		bool again = err && ++it->attempts < rq->limit;
+		if (!again && !rq->finish(rq->data, it->src, it->dst, it->mode, err))
+			atomic_store_explicit(&rq->failed, true, memory_order_relaxed);
+		g_mutex_lock(&rq->mutex);
+
+		if (again) {
+			it->due = g_get_monotonic_time() + retryDelay(it->attempts);
+			pushItem(rq, it);
+		} else
+			releaseItem(rq, it);
+	}
+	g_mutex_unlock(&rq->mutex);
+	return NULL;
+}
+
+RetryQueue* startRetries(uint limit, RetryAttempt attempt, RetryFinish finish, void* data) {
+	RetryQueue* rq = malloc(sizeof(RetryQueue));
+	rq->lim = 16;
+	rq->heap = malloc(rq->lim * sizeof(RetryItem*));
+	rq->count = 0;
+	rq->active = 0;
+	rq->busy = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	rq->waiting = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	rq->attempt = attempt;
+	rq->finish = finish;
+	rq->data = data;
+	rq->limit = limit;
+	rq->stop = false;
+	atomic_init(&rq->failed, false);
+	g_mutex_init(&rq->mutex);
+	g_cond_init(&rq->cond);
+	rq->thread = g_thread_new("retry", (GThreadFunc)retryProc, rq);
+	return rq;
+}
+
+void queueRetry(RetryQueue* rq, const char* src, const char* dst, int mode) {
+	size_t slen = strlen(src);
+	size_t dlen = strlen(dst);
+	RetryItem* it = malloc(sizeof(RetryItem) + (slen + dlen + 2) * sizeof(char));
+	memcpy(it->src, src, (slen + 1) * sizeof(char));
+	it->dst = it->src + slen + 1;
+	memcpy(it->dst, dst, (dlen + 1) * sizeof(char));
+	it->attempts = 0;
+	it->mode = mode;
+	it->due = g_get_monotonic_time() + retryDelay(0);
+
+	g_mutex_lock(&rq->mutex);
+	markBusy(rq, it->src, true);
+	markBusy(rq, it->dst, true);
+	++rq->active;
+	pushItem(rq, it);
+	g_cond_broadcast(&rq->cond);
+	g_mutex_unlock(&rq->mutex);
+}
+
+// a later rename that touches the paths of a waiting one has to wait for it, or it could take the name that one is about to free or fill
+void waitRetries(RetryQueue* rq, const char* src, const char* dst) {
+	g_mutex_lock(&rq->mutex);
+	while (rq->active && (g_hash_table_contains(rq->busy, src) || g_hash_table_contains(rq->busy, dst) || insideWaiting(rq->waiting, src) || insideWaiting(rq->waiting, dst)))
+		g_cond_wait(&rq->cond, &rq->mutex);
+	g_mutex_unlock(&rq->mutex);
+}
+
+bool drainRetries(RetryQueue* rq) {
+	g_mutex_lock(&rq->mutex);
+	while (rq->active)
+		g_cond_wait(&rq->cond, &rq->mutex);
+	g_mutex_unlock(&rq->mutex);
+	return !retriesFailed(rq);
+}
+
+bool retriesFailed(const RetryQueue* rq) {
+	return atomic_load_explicit(&rq->failed, memory_order_relaxed);
+}
+
+bool stopRetries(RetryQueue* rq) {
+	g_mutex_lock(&rq->mutex);
+	rq->stop = true;
+	g_cond_broadcast(&rq->cond);
+	g_mutex_unlock(&rq->mutex);
+	g_thread_join(rq->thread);
+
+	bool ok = !retriesFailed(rq);
+	g_hash_table_destroy(rq->busy);
+	g_hash_table_destroy(rq->waiting);
+	g_cond_clear(&rq->cond);
+	g_mutex_clear(&rq->mutex);
+	free(rq->heap);
+	free(rq);
+	return ok;
+}
@@ -0,0 +1,20 @@
+#ifndef RETRY_H
+#define RETRY_H
+
+#include "utils.h"
+
+#define RETRY_LIMIT_DEFAULT 5
+#define RETRY_LIMIT_MAX 30
+
+typedef int (*RetryAttempt)(void* data, const char* src, const char* dst, int mode);
+typedef bool (*RetryFinish)(void* data, const char* src, const char* dst, int mode, int err);
+
+gint64 retryDelay(uint attempts);
+RetryQueue* startRetries(uint limit, RetryAttempt attempt, RetryFinish finish, void* data);
+void queueRetry(RetryQueue* rq, const char* src, const char* dst, int mode);
+void waitRetries(RetryQueue* rq, const char* src, const char* dst);
+bool drainRetries(RetryQueue* rq);
+bool retriesFailed(const RetryQueue* rq);
+bool stopRetries(RetryQueue* rq);
+
+#endif
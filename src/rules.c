@@ -0,0 +1,104 @@
+#include "rules.h"
+#include "filter.h"
+#include <sys/stat.h>
+
+#define KEY_MATCH "match"
+#define KEY_EXCLUDE "exclude"
+#define KEY_MIN_SIZE "min-size"
+#define KEY_MAX_SIZE "max-size"
+#define KEY_OPTIONS "options"
+
+static char** readRuleList(GKeyFile* kf, const char* group, const char* key, GError** err) {
+	return g_key_file_has_key(kf, group, key, NULL) ? g_key_file_get_string_list(kf, group, key, NULL, err) : NULL;
+}
+
+static bool readRuleSize(GKeyFile* kf, const char* group, const char* key, uint64_t* size, GError** err) {
+	if (!g_key_file_has_key(kf, group, key, NULL))
+		return true;
+	*size = g_key_file_get_uint64(kf, group, key, err);
+	return !*err;
+}
+
+static bool loadRule(Rule* rule, GKeyFile* kf, const char* group, GError** err) {
+	rule->maxSize = UINT64_MAX;
+	char** match = readRuleList(kf, group, KEY_MATCH, err);
+	char** exclude = !*err ? readRuleList(kf, group, KEY_EXCLUDE, err) : NULL;
+	rule->filter = newFilter(match, exclude);
+	g_strfreev(match);
+	g_strfreev(exclude);
+	if (*err || !readRuleSize(kf, group, KEY_MIN_SIZE, &rule->minSize, err) || !readRuleSize(kf, group, KEY_MAX_SIZE, &rule->maxSize, err))
+		return false;
+	rule->sized = rule->minSize || rule->maxSize != UINT64_MAX;
+
+	char* options = g_key_file_has_key(kf, group, KEY_OPTIONS, NULL) ? g_key_file_get_string(kf, group, KEY_OPTIONS, err) : NULL;
+	bool ok = !*err && parseArgumentString(&rule->args, options ? options : "", err);
+	g_free(options);
+	return ok;
+}
+
+bool loadRules(RuleSet* rs, const char* file, Window* win) {
+	memset(rs, 0, sizeof(RuleSet));
+	if (!file)
+		return true;
+
+	GError* err = NULL;
+	GKeyFile* kf = g_key_file_new();
+	if (!g_key_file_load_from_file(kf, file, G_KEY_FILE_NONE, &err)) {
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to load rules '%s': %s", file, err->message);
+		g_clear_error(&err);
+		g_key_file_free(kf);
+		return false;
+	}
+
+	gsize cnt;
+	char** groups = g_key_file_get_groups(kf, &cnt);
+	rs->rules = calloc(cnt, sizeof(Rule));
+	for (size_t i = 0; i < cnt; ++i) {
+		Rule* it = &rs->rules[rs->count++];
+		if (!loadRule(it, kf, groups[i], &err)) {
+			showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Invalid rule '%s' in '%s': %s", groups[i], file, err->message);
+			g_clear_error(&err);
+			g_strfreev(groups);
+			g_key_file_free(kf);
+			freeRules(rs);
+			return false;
+		}
+		rs->typed |= filterTyped(it->filter);
+	}
+	g_strfreev(groups);
+	g_key_file_free(kf);
+	return true;
+}
+
+// the rules are tried in the order of the file and the file is only looked up once the first rule needs it
+Rule* matchRule(const RuleSet* rs, const char* path, const char* name, const FileMeta* meta) {
+	uint64_t size = 0;
+	bool isDir = false;
+	bool known = false;
+	for (size_t i = 0; i < rs->count; ++i) {
+		Rule* it = &rs->rules[i];
+		if ((it->sized || filterTyped(it->filter)) && !known) {
+			struct stat ps;
+			if ((rs->typed || !meta) && !stat(path, &ps)) {
+				size = ps.st_size;
+				isDir = S_ISDIR(ps.st_mode);
+			}
+			if (meta)
+				size = meta->size;
+			known = true;
+		}
+		if (filterName(it->filter, name, isDir) && (!it->sized || (size >= it->minSize && size <= it->maxSize)))
+			return it;
+	}
+	return NULL;
+}
+
+void freeRules(RuleSet* rs) {
+	for (size_t i = 0; i < rs->count; ++i) {
+		freeFilter(rs->rules[i].filter);
+		freeArguments(&rs->rules[i].args);
+	}
+	free(rs->rules);
+	rs->rules = NULL;
+	rs->count = 0;
+}
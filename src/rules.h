@@ -0,0 +1,25 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include "arguments.h"
+
+typedef struct Rule {
+	Arguments args;
+	Filter* filter;
+	Process* proc;
+	uint64_t minSize;
+	uint64_t maxSize;
+	bool sized;
+} Rule;
+
+typedef struct RuleSet {
+	Rule* rules;
+	size_t count;
+	bool typed;
+} RuleSet;
+
+bool loadRules(RuleSet* rs, const char* file, Window* win);
+Rule* matchRule(const RuleSet* rs, const char* path, const char* name, const FileMeta* meta);
+void freeRules(RuleSet* rs);
+
+#endif
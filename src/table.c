@@ -1,4 +1,5 @@
 #ifndef CONSOLE
+#include "input.h"
 #include "rename.h"
 #include "table.h"
 #include "window.h"
@@ -12,6 +13,7 @@
 typedef struct FileEntry {
 	Window* win;
 	FileInfo* info;
+	FileMeta* meta;
 	size_t dlen;
 	char file[];
 } FileEntry;
@@ -22,10 +24,11 @@ typedef struct FileDetails {
 	FileInfo* info;
 } FileDetails;
 
-typedef struct ArgumentFiles {
+typedef struct ListFiles {
 	Window* win;
-	char* files[];
-} ArgumentFiles;
+	Input in;
+	char* paths[];
+} ListFiles;
 
 typedef struct ClipboardFiles {
 	Window* win;
@@ -77,12 +80,21 @@ static gboolean appendFile(FileEntry* entry) {
 	} else
 		gtk_list_store_set(win->lsFiles, &win->lastFile, FCOL_OLD_NAME, entry->file + entry->dlen, FCOL_NEW_NAME, entry->file + entry->dlen, FCOL_DIRECTORY, entry->file, FCOL_INVALID);
 
+	// a path that is added again without metadata mustn't keep the values of an earlier list
+	char* path = g_strconcat(entry->file, entry->file + entry->dlen, NULL);
+	if (entry->meta)
+		g_hash_table_replace(win->fileMeta, path, entry->meta);
+	else {
+		g_hash_table_remove(win->fileMeta, path);
+		g_free(path);
+	}
+
 	win->lastFilePtr = &win->lastFile;
 	free(entry);
 	return G_SOURCE_REMOVE;
 }
 
-static void addFile(Window* win, const char* file) {
+static void addFile(Window* win, const char* file, const FileMeta* meta) {
 	if (!g_utf8_validate(file, -1, NULL)) {
 		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Invalid UTF-8 input path");
 		return;
@@ -103,13 +115,17 @@ static void addFile(Window* win, const char* file) {
 	FileEntry* entry = malloc(sizeof(FileEntry) + (flen + 2) * sizeof(char));
 	entry->win = win;
 	entry->info = NULL;
+	entry->meta = meta ? memcpy(malloc(sizeof(FileMeta)), meta, sizeof(FileMeta)) : NULL;
 	entry->dlen = dlen + 1;
 	memcpy(entry->file, file, dlen * sizeof(char));
 	entry->file[dlen] = '\0';
 	memcpy(entry->file + entry->dlen, file + dlen, (nlen + 1) * sizeof(char));
 	if (win->sets.showDetails) {
 		entry->info = malloc(sizeof(FileInfo));
-		setFileInfo(file, entry->info);
+		if (meta)
+			setFileInfoMeta(meta, entry->info);
+		else
+			setFileInfo(file, entry->info);
 	}
 	g_idle_add(G_SOURCE_FUNC(appendFile), entry);
 }
@@ -147,11 +163,11 @@ static void* runAddDialogProc(DialogFiles* dgf) {
 		if (plen < PATH_MAX) {
 			memcpy(path, it->data, (plen + 1) * sizeof(char));
 			unbackslashify(path);
-			addFile(dgf->win, path);
+			addFile(dgf->win, path, NULL);
 		} else
 			showMessage(dgf->win, MESSAGE_ERROR, BUTTONS_OK, "Path '%s' is too long", (char*)dgf->files->data);
 #else
-		addFile(dgf->win, it->data);
+		addFile(dgf->win, it->data, NULL);
 #endif
 		++prc->id;
 		g_idle_add(G_SOURCE_FUNC(updateProgressBar), win);
@@ -173,52 +189,67 @@ void addFilesFromDialog(Window* win, GSList* files) {
 	runThread(win, THREAD_POPULATE, (GThreadFunc)runAddDialogProc, G_SOURCE_FUNC(runAddDialogFinish), dgf);
 }
 
-static gboolean processArgumentFilesFinish(ArgumentFiles* af) {
-	finishThread(af->win);
-	setWidgetsSensitive(af->win, true);
-	for (size_t i = 0; i < af->win->proc->total; ++i)
-		free(af->files[i]);
-	free(af);
+static gboolean addFilesFromListFinish(ListFiles* lf) {
+	finishThread(lf->win);
+	setWidgetsSensitive(lf->win, true);
+	closeInput(&lf->in);
+	free(lf);
 	return G_SOURCE_REMOVE;
 }
 
-static void* processArgumentFilesProc(ArgumentFiles* af) {
-	Window* win = af->win;
+static void* addFilesFromListProc(ListFiles* lf) {
+	Window* win = lf->win;
 	Process* prc = win->proc;
-#ifdef _WIN32
-	char buf[PATH_MAX];
-#endif
-	for (prc->id = 0; prc->id < prc->total && win->threadCode == THREAD_POPULATE;) {
-#ifdef _WIN32
-		size_t fsiz = strlen(af->files[prc->id]) + 1;
-		if (fsiz >= PATH_MAX) {
-			g_printerr("Filepath '%s' is too long\n", af->files[prc->id]);
-			continue;
-		}
-		memcpy(buf, af->files[prc->id], fsiz * sizeof(char));
-		unbackslashify(buf);
-		addFile(win, buf);
-#else
-		addFile(win, af->files[prc->id]);
-#endif
-		++prc->id;
-		g_idle_add(G_SOURCE_FUNC(updateProgressBar), win);
+	const char* path;
+	size_t plen;
+	for (prc->id = 0; win->threadCode == THREAD_POPULATE && (path = nextInput(&lf->in, prc->id, &plen)); ++prc->id) {
+		addFile(win, path, lf->in.hasMeta ? &lf->in.meta : NULL);
+		if (!inputStreamed(&lf->in))
+			g_idle_add(G_SOURCE_FUNC(updateProgressBar), win);
 	}
-	g_idle_add(G_SOURCE_FUNC(processArgumentFilesFinish), af);
+	g_idle_add(G_SOURCE_FUNC(addFilesFromListFinish), lf);
 	return NULL;
 }
 
-void addFilesFromArguments(Window* win, GFile** files, size_t nFiles) {
-	ArgumentFiles* af = malloc(sizeof(ArgumentFiles) + (sizeof(char*) * nFiles));
-	af->win = win;
-	for (size_t i = 0; i < nFiles; ++i)
-		af->files[i] = strdup(g_file_peek_path(files[i]));
-
+static void startFileList(Window* win, ListFiles* lf) {
+	lf->win = win;
 	Process* prc = win->proc;
 	prc->forward = true;
-	prc->total = nFiles;
+	prc->total = inputStreamed(&lf->in) ? 0 : lf->in.nPaths;
 	startFileAppend(win);
-	runThread(win, THREAD_POPULATE, (GThreadFunc)processArgumentFilesProc, G_SOURCE_FUNC(processArgumentFilesFinish), af);
+	runThread(win, THREAD_POPULATE, (GThreadFunc)addFilesFromListProc, G_SOURCE_FUNC(addFilesFromListFinish), lf);
+}
+
+void addFilesFromArguments(Window* win, const Arguments* arg, GFile** files, size_t nFiles) {
+	// all paths are packed into the same allocation behind the pointers to them
+	size_t tlen = 0;
+	for (size_t i = 0; i < nFiles; ++i)
+		tlen += strlen(g_file_peek_path(files[i])) + 1;
+	ListFiles* lf = malloc(sizeof(ListFiles) + nFiles * sizeof(char*) + tlen * sizeof(char));
+	char* pos = (char*)(lf->paths + nFiles);
+	for (size_t i = 0; i < nFiles; ++i) {
+		const char* path = g_file_peek_path(files[i]);
+		size_t plen = strlen(path) + 1;
+		lf->paths[i] = memcpy(pos, path, plen * sizeof(char));
+		pos += plen;
+	}
+
+	if (openInput(&lf->in, arg, lf->paths, nFiles, win))
+		startFileList(win, lf);
+	else {
+		closeInput(&lf->in);
+		free(lf);
+	}
+}
+
+void addFilesFromList(Window* win, const Arguments* arg) {
+	ListFiles* lf = malloc(sizeof(ListFiles));
+	if (openInput(&lf->in, arg, NULL, 0, win))
+		startFileList(win, lf);
+	else {
+		closeInput(&lf->in);
+		free(lf);
+	}
 }
 
 static FileDetails* newFileDetails(Window* win, FileInfo* info) {
@@ -271,7 +302,11 @@ static void* toggleShowDetailsProc(Window* win) {
 				memcpy(path + dlen, name, (nlen + 1) * sizeof(char));
 
 				FileDetails* details = newFileDetails(win, malloc(sizeof(FileInfo)));
-				setFileInfo(path, details->info);
+				const FileMeta* meta = g_hash_table_lookup(win->fileMeta, path);
+				if (meta)
+					setFileInfoMeta(meta, details->info);
+				else
+					setFileInfo(path, details->info);
 				g_idle_add(G_SOURCE_FUNC(setFileDetails), details);
 			}
 			g_free(name);
@@ -331,9 +366,9 @@ static void addFileUris(Window* win, char** uris) {
 			char* fpath = g_uri_unescape_string(uris[prc->id] + flen, "/");
 			if (fpath) {
 #ifdef _WIN32
-				addFile(win, fpath + (fpath[0] == '/' && isalnum(fpath[1]) && fpath[2] == ':' && fpath[3] == '/'));
+				addFile(win, fpath + (fpath[0] == '/' && isalnum(fpath[1]) && fpath[2] == ':' && fpath[3] == '/'), NULL);
 #else
-				addFile(win, fpath);
+				addFile(win, fpath, NULL);
 #endif
 				g_free(fpath);
 			} else
@@ -513,7 +548,7 @@ static void* addClipboardFilesProc(ClipboardFiles* cbf) {
 			size_t i = strcspn(pos, LINE_BREAK_CHARS);
 			bool more = pos[i] != '\0';
 			pos[i] = '\0';
-			addFile(cbf->win, pos);
+			addFile(cbf->win, pos, NULL);
 			pos += i + more;
 			++prc->id;
 			g_idle_add(G_SOURCE_FUNC(updateProgressBar), win);
@@ -5,7 +5,8 @@
 #include "utils.h"
 
 void addFilesFromDialog(Window* win, GSList* files);
-void addFilesFromArguments(Window* win, GFile** files, size_t nFiles);
+void addFilesFromArguments(Window* win, const Arguments* arg, GFile** files, size_t nFiles);
+void addFilesFromList(Window* win, const Arguments* arg);
 void setDetailsVisible(Window* win);
 G_MODULE_EXPORT void dragEndTblFiles(GtkWidget* widget, GdkDragContext* context, Window* win);
 
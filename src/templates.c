@@ -7,7 +7,7 @@
 #include <sys/stat.h>
 
 #define TEMPLATES_UI_NAME "templates.ui.gz"
-#define TEMPLATE_VERSION 0
+#define TEMPLATE_VERSION 1
 
 typedef struct Templates {
 	Window* win;
@@ -213,7 +213,7 @@ Arguments* loadTemplateFile(Settings* set, const char* name, char** error) {
 	free(path);
 
 	uint32_t version = readUint32(fd);
-	if (version != TEMPLATE_VERSION) {
+	if (version > TEMPLATE_VERSION) {
 		*error = g_strdup_printf("Invalid file Version. Expected: %u Got: %u", TEMPLATE_VERSION, version);
 		fclose(fd);
 		return NULL;
@@ -259,6 +259,8 @@ Arguments* loadTemplateFile(Settings* set, const char* name, char** error) {
 	arg->dateFormat = readString(fd);
 	arg->dateLocation = readSint16(fd);
 
+	arg->destinationMode = version >= 1 ? readUint8(fd) : DESTINATION_IN_PLACE;
+
 	if (ferror(fd)) {
 		*error = g_strdup("Failed to read file");
 		freeArguments(arg);
@@ -266,6 +268,12 @@ Arguments* loadTemplateFile(Settings* set, const char* name, char** error) {
 		return NULL;
 	}
 	fclose(fd);
+	// the mode indexes the rename functions, so a damaged file mustn't get past this
+	if (arg->destinationMode > DESTINATION_HARDLINK) {
+		*error = g_strdup_printf("Invalid destination mode %u", (uint)arg->destinationMode);
+		freeArguments(arg);
+		return NULL;
+	}
 	setMostRecentTemplate(set, name);
 	return arg;
 }
@@ -356,6 +364,8 @@ static bool saveFile(Templates* tpl, const char* name) {
 	writeString(fd, gtk_entry_get_text(win->etDateFormat));
 	writeSint16(fd, gtk_spin_button_get_value_as_int(win->sbDateLocation));
 
+	writeUint8(fd, gtk_combo_box_get_active(GTK_COMBO_BOX(win->cmbDestinationMode)));
+
 	if (ferror(fd)) {
 		stDlgMessageNoArg(GTK_WINDOW(tpl->dialog), GTK_MESSAGE_ERROR, "Failed to write file")
 		fclose(fd);
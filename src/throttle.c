@@ -0,0 +1,52 @@
+#include "throttle.h"
+
+#define THROTTLE_CHUNK_MIN 4096
+#define THROTTLE_CHUNKS_PER_SEC 10
+
+struct Throttle {
+	GMutex mutex;
+	double rate;
+	double tokens;
+	gint64 last;
+	size_t chunk;
+};
+
+Throttle* newThrottle(uint64_t rate) {
+	if (!rate)
+		return NULL;
+
+	Throttle* th = malloc(sizeof(Throttle));
+	g_mutex_init(&th->mutex);
+	th->rate = (double)rate;
+	th->tokens = th->rate;
+	th->last = g_get_monotonic_time();
+	th->chunk = MAX(rate / THROTTLE_CHUNKS_PER_SEC, THROTTLE_CHUNK_MIN);
+	return th;
+}
+
+// large transfers are split up so that the waits stay short and other tenants see an even load
+size_t throttleChunk(const Throttle* th, size_t size) {
+	return th ? MIN(size, th->chunk) : size;
+}
+
+// the bucket holds at most one second's worth and is paid after the fact, so a cost larger than that only makes the caller wait longer
+void throttle(Throttle* th, uint64_t amount) {
+	if (!th)
+		return;
+
+	g_mutex_lock(&th->mutex);
+	gint64 now = g_get_monotonic_time();
+	th->tokens = MIN(th->tokens + (double)(now - th->last) * th->rate / G_USEC_PER_SEC, th->rate) - (double)amount;
+	th->last = now;
+	gint64 wait = th->tokens < 0.0 ? (gint64)(-th->tokens * G_USEC_PER_SEC / th->rate) : 0;
+	g_mutex_unlock(&th->mutex);
+	if (wait)
+		g_usleep(wait);
+}
+
+void freeThrottle(Throttle* th) {
+	if (th) {
+		g_mutex_clear(&th->mutex);
+		free(th);
+	}
+}
@@ -0,0 +1,11 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include "utils.h"
+
+Throttle* newThrottle(uint64_t rate);
+size_t throttleChunk(const Throttle* th, size_t size);
+void throttle(Throttle* th, uint64_t amount);
+void freeThrottle(Throttle* th);
+
+#endif
@@ -187,6 +187,17 @@ void setFileInfo(const char* file, FileInfo* info) {
 #endif
 }
 
+void setFileInfoMeta(const FileMeta* meta, FileInfo* info) {
+	memset(info, 0, sizeof(FileInfo));
+	info->size = meta->size >= 1024 ? g_format_size_full(meta->size, G_FORMAT_SIZE_IEC_UNITS) : g_strdup_printf("%u B", (uint)meta->size);
+#ifndef _WIN32
+	const struct passwd* pwd = getpwuid(meta->uid);
+	info->user = pwd ? strdup(pwd->pw_name) : NULL;
+	timespecToStr(meta->mtime, info->modify);
+	timespecToStr(meta->ctime, info->change);
+#endif
+}
+
 void freeFileInfo(FileInfo* info) {
 	free(info->size);
 	free(info->user);
@@ -464,6 +475,81 @@ char* newStrncat(uint n, ...) {
 	return str;
 }
 
+// the root directory loses its separator, so that a relative path can always be joined with one
+char* workingDirectory(void) {
+	char* dir = g_get_current_dir();
+#ifdef _WIN32
+	unbackslashify(dir);
+#endif
+	size_t len = strlen(dir);
+	if (len && dir[len - 1] == '/')
+		dir[len - 1] = '\0';
+	return dir;
+}
+
+// the root of a path without its trailing separators, which a parent reference can't go above
+static size_t rootLength(const char* path) {
+	size_t len = g_path_is_absolute(path) ? (size_t)(g_path_skip_root(path) - path) : 0;
+	for (; len && G_IS_DIR_SEPARATOR(path[len - 1]); --len);
+	return len;
+}
+
+// a relative path is joined to the directory and cleaned up like GFile does, which needs room for both and two more characters
+char* resolvePath(char* dst, const char* dir, const char* src) {
+	char* start = dst;
+	char* root;
+	if (g_path_is_absolute(src)) {
+		const char* rel = g_path_skip_root(src);
+		size_t rlen = rootLength(src);
+		memcpy(dst, src, rlen * sizeof(char));
+		dst += rlen;
+		root = dst;
+		src = rel;
+	} else {
+		size_t dlen = strlen(dir);
+		memcpy(dst, dir, dlen * sizeof(char));
+		root = dst + rootLength(dir);
+		dst += dlen;
+	}
+	while (*src) {
+		for (; G_IS_DIR_SEPARATOR(*src); ++src);
+		size_t slen = 0;
+		for (; src[slen] && !G_IS_DIR_SEPARATOR(src[slen]); ++slen);
+		if (slen == 2 && src[0] == '.' && src[1] == '.')
+			while (dst > root && *--dst != '/');
+		else if (slen && (slen != 1 || src[0] != '.')) {
+			*dst++ = '/';
+			memcpy(dst, src, slen * sizeof(char));
+			dst += slen;
+		}
+		src += slen;
+	}
+	if (dst == start)
+		*dst++ = '/';
+#ifdef _WIN32
+	else if (dst[-1] == ':')
+		*dst++ = '/';
+#endif
+	*dst = '\0';
+	return dst;
+}
+
+// all paths are packed into one allocation behind the pointers to them
+char** resolvePaths(char** paths, size_t count) {
+	char* cwd = workingDirectory();
+	size_t clen = strlen(cwd), tlen = 0;
+	for (size_t i = 0; i < count; ++i)
+		tlen += clen + strlen(paths[i]) + 2;
+	char** res = malloc(count * sizeof(char*) + tlen * sizeof(char));
+	char* pos = (char*)(res + count);
+	for (size_t i = 0; i < count; ++i) {
+		res[i] = pos;
+		pos = resolvePath(pos, cwd, paths[i]) + 1;
+	}
+	g_free(cwd);
+	return res;
+}
+
 #ifdef _WIN32
 void* memrchr(const void* s, int c, size_t n) {
 	uint8_t* p = (uint8_t*)s;
@@ -33,8 +33,18 @@ typedef long long llong;
 typedef unsigned long long ullong;
 
 typedef struct Arguments Arguments;
+typedef struct ErrorPolicy ErrorPolicy;
+typedef struct ErrorReport ErrorReport;
+typedef struct Filter Filter;
+typedef struct NameIndex NameIndex;
+typedef struct Output Output;
+typedef struct Plan Plan;
 typedef struct Process Process;
+typedef struct RetryQueue RetryQueue;
 typedef struct Settings Settings;
+typedef struct SourceIndex SourceIndex;
+typedef struct Throttle Throttle;
+typedef struct Walker Walker;
 typedef struct Window Window;
 
 typedef enum RenameMode {
@@ -50,7 +60,8 @@ typedef enum DestinationMode {
 	DESTINATION_IN_PLACE,
 	DESTINATION_MOVE,
 	DESTINATION_COPY,
-	DESTINATION_LINK
+	DESTINATION_LINK,
+	DESTINATION_HARDLINK
 } DestinationMode;
 
 typedef enum DateMode {
@@ -61,6 +72,19 @@ typedef enum DateMode {
 	DATE_CHANGE
 } DateMode;
 
+typedef enum CollisionMode {
+	COLLISION_OVERWRITE,
+	COLLISION_SKIP,
+	COLLISION_SUFFIX,
+	COLLISION_NUMBER
+} CollisionMode;
+
+typedef enum OutputFormat {
+	OUTPUT_TEXT,
+	OUTPUT_NUL,
+	OUTPUT_JSON
+} OutputFormat;
+
 typedef enum ResponseType {
 	RESPONSE_WAIT,
 	RESPONSE_NONE = -1,
@@ -93,6 +117,13 @@ typedef enum ButtonsType {
 	BUTTONS_OK_CANCEL
 } ButtonsType;
 
+typedef struct FileMeta {
+	uint64_t size;
+	int64_t mtime;
+	int64_t ctime;
+	uint32_t uid;
+} FileMeta;
+
 #ifndef CONSOLE
 typedef enum ThreadCode {
 	THREAD_NONE,
@@ -129,6 +160,7 @@ typedef struct FileInfo {
 void runThread(Window* win, ThreadCode code, GThreadFunc proc, GSourceFunc fin, void* data);
 void finishThread(Window* win);
 void setFileInfo(const char* file, FileInfo* info);
+void setFileInfoMeta(const FileMeta* meta, FileInfo* info);
 void freeFileInfo(FileInfo* info);
 GtkTreeRowReference** getTreeViewSelectedRowRefs(GtkTreeView* view, GtkTreeModel** model, uint* cnt);
 void sortTreeViewColumn(GtkTreeView* treeView, GtkListStore* listStore, int colId, bool ascending);
@@ -141,6 +173,9 @@ llong strToLlong(const char* str, uint8_t base);
 size_t llongToRevStr(char* buf, llong num, uint8_t base, const char* digits);
 size_t llongToStr(char* buf, llong num, uint8_t base, bool upper);
 char* newStrncat(uint n, ...);
+char* workingDirectory(void);
+char* resolvePath(char* dst, const char* dir, const char* src);
+char** resolvePaths(char** paths, size_t count);
 
 #ifdef _WIN32
 void* memrchr(const void* s, int c, size_t n);
@@ -0,0 +1,67 @@
+#include "verify.h"
+#include "rename.h"
+#include "throttle.h"
+
+#define VERIFY_BUFFER_SIZE (1024 * 1024)
+
+typedef struct VerifyTask {
+	uint64_t hash;
+	char path[];
+} VerifyTask;
+
+static void verifyFile(VerifyTask* task, Process* prc) {
+	bool ok = false;
+	FILE* fp = fopen(task->path, "rb");
+	if (fp) {
+		HashState hs;
+		hashInit(&hs);
+		char* buf = malloc(VERIFY_BUFFER_SIZE);
+		size_t len;
+		while ((len = fread(buf, sizeof(char), throttleChunk(prc->bytesLimit, VERIFY_BUFFER_SIZE), fp))) {
+			hashUpdate(&hs, buf, len);
+			throttle(prc->bytesLimit, len);
+		}
+		ok = !ferror(fp) && hashDigest(&hs) == task->hash;
+		free(buf);
+		fclose(fp);
+	}
+
+	if (!ok) {
+		g_mutex_lock(&prc->verifyMutex);
+		g_ptr_array_add(prc->verifyFails, g_strdup(task->path));
+		g_mutex_unlock(&prc->verifyMutex);
+	}
+	free(task);
+}
+
+void initVerify(Process* prc) {
+	g_mutex_init(&prc->verifyMutex);
+	prc->verifyFails = g_ptr_array_new_with_free_func(g_free);
+	prc->verifyPool = g_thread_pool_new((GFunc)verifyFile, prc, (int)g_get_num_processors(), FALSE, NULL);
+}
+
+void queueVerify(Process* prc, const char* path, uint64_t hash) {
+	size_t plen = strlen(path);
+	VerifyTask* task = malloc(sizeof(VerifyTask) + (plen + 1) * sizeof(char));
+	task->hash = hash;
+	memcpy(task->path, path, (plen + 1) * sizeof(char));
+	g_thread_pool_push(prc->verifyPool, task, NULL);
+}
+
+void finishVerify(Process* prc, Window* win) {
+	if (!prc->verifyPool)
+		return;
+
+	g_thread_pool_free(prc->verifyPool, FALSE, TRUE);
+	prc->verifyPool = NULL;
+	if (prc->verifyFails->len) {
+		GString* str = g_string_new(NULL);
+		for (guint i = 0; i < prc->verifyFails->len; ++i)
+			g_string_append_printf(str, "\n%s", (const char*)g_ptr_array_index(prc->verifyFails, i));
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Verification failed for %u of the copied files:%s", prc->verifyFails->len, str->str);
+		g_string_free(str, TRUE);
+	}
+	g_ptr_array_free(prc->verifyFails, TRUE);
+	prc->verifyFails = NULL;
+	g_mutex_clear(&prc->verifyMutex);
+}
@@ -0,0 +1,11 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "utils.h"
+#include "hash.h"
+
+void initVerify(Process* prc);
+void queueVerify(Process* prc, const char* path, uint64_t hash);
+void finishVerify(Process* prc, Window* win);
+
+#endif
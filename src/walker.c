@@ -0,0 +1,317 @@
+#include "walker.h"
+#include "arguments.h"
+#include "filter.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define WALK_PREFETCH 64
+#define WALK_BUFFER_SIZE 65536
+#define ENTRY_FILE 'f'
+#define ENTRY_DIR 'd'
+
+typedef struct WalkDir {
+	struct WalkDir** subs;
+	size_t* subIds;
+	char* names;
+	char** entries;
+	size_t count;
+	size_t next;
+	size_t nSubs;
+	size_t nextSub;
+	size_t submitted;
+	size_t slot;
+	size_t plen;
+	int depth;
+	int err;
+	bool listed;
+	bool entered;
+	char path[];
+} WalkDir;
+
+typedef struct Listing {
+	char* names;
+	size_t* offs;
+	size_t len;
+	size_t cap;
+	size_t count;
+	size_t ocap;
+} Listing;
+
+struct Walker {
+	GThreadPool* pool;
+	GPtrArray* stack;
+	GMutex mutex;
+	GCond cond;
+	const Filter* filter;
+	int64_t maxDepth;
+	dev_t rootDev;
+	bool oneFs;
+	bool filesOnly;
+	bool dirsOnly;
+};
+
+static WalkDir* newWalkDir(const char* dirc, size_t dlen, const char* name, size_t nlen, int depth) {
+	bool sep = nlen && dirc[dlen - 1] != '/';
+	WalkDir* dir = calloc(1, sizeof(WalkDir) + (dlen + sep + nlen + 1) * sizeof(char));
+	memcpy(dir->path, dirc, dlen * sizeof(char));
+	if (sep)
+		dir->path[dlen] = '/';
+	memcpy(dir->path + dlen + sep, name, nlen * sizeof(char));
+	dir->plen = dlen + sep + nlen;
+	dir->depth = depth;
+	return dir;
+}
+
+static void freeWalkDir(WalkDir* dir) {
+	for (size_t i = 0; i < dir->submitted; ++i)
+		if (dir->subs[i])
+			freeWalkDir(dir->subs[i]);
+	free(dir->subs);
+	free(dir->subIds);
+	free(dir->entries);
+	free(dir->names);
+	free(dir);
+}
+
+static void addEntry(Listing* ls, bool isDir, const char* name) {
+	size_t nlen = strlen(name);
+	if (ls->len + nlen + 2 > ls->cap) {
+		ls->cap = MAX(ls->cap * 2, ls->len + nlen + 2);
+		ls->names = realloc(ls->names, ls->cap * sizeof(char));
+	}
+	if (ls->count == ls->ocap) {
+		ls->ocap = ls->ocap ? ls->ocap * 2 : 64;
+		ls->offs = realloc(ls->offs, ls->ocap * sizeof(size_t));
+	}
+	ls->offs[ls->count++] = ls->len;
+	ls->names[ls->len] = isDir ? ENTRY_DIR : ENTRY_FILE;
+	memcpy(ls->names + ls->len + 1, name, (nlen + 1) * sizeof(char));
+	ls->len += nlen + 2;
+}
+
+static bool isDotName(const char* name) {
+	return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+
+static int compareEntries(const void* a, const void* b) {
+	return strcmp(*(char* const*)a + 1, *(char* const*)b + 1);
+}
+
+static void listDirectory(WalkDir* dir, Walker* wlk) {
+	Listing ls = { 0 };
+	int err = 0;
+#ifdef __linux__
+	int fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1)
+		err = errno;
+	else {
+		// a mount point is still returned as an entry, but its contents aren't
+		struct stat ps;
+		if (!wlk->oneFs || !dir->depth || (!fstat(fd, &ps) && ps.st_dev == wlk->rootDev)) {
+			char* buf = malloc(WALK_BUFFER_SIZE);
+			long rlen;
+			while ((rlen = syscall(SYS_getdents64, fd, buf, WALK_BUFFER_SIZE)) > 0)
+				for (long pos = 0; pos < rlen;) {
+					const struct dirent64* de = (const void*)(buf + pos);
+					pos += de->d_reclen;
+					if (isDotName(de->d_name))
+						continue;
+
+					bool isDir = de->d_type == DT_DIR;
+					if (de->d_type == DT_UNKNOWN) {
+						struct stat es;
+						isDir = !fstatat(fd, de->d_name, &es, AT_SYMLINK_NOFOLLOW) && S_ISDIR(es.st_mode);
+					}
+					addEntry(&ls, isDir, de->d_name);
+				}
+			if (rlen < 0)
+				err = errno;
+			free(buf);
+		}
+		close(fd);
+	}
+#else
+	struct stat ps;
+	DIR* dp = opendir(dir->path);
+	if (!dp)
+		err = errno;
+	else if (!wlk->oneFs || !dir->depth || (!stat(dir->path, &ps) && ps.st_dev == wlk->rootDev)) {
+		char path[PATH_MAX];
+		size_t plen = dir->plen + (dir->path[dir->plen - 1] != '/');
+		memcpy(path, dir->path, dir->plen * sizeof(char));
+		path[plen - 1] = '/';
+		for (struct dirent* de = readdir(dp); de; de = readdir(dp)) {
+			size_t nlen = strlen(de->d_name);
+			if (isDotName(de->d_name) || plen + nlen >= PATH_MAX)
+				continue;
+
+			struct stat es;
+			memcpy(path + plen, de->d_name, (nlen + 1) * sizeof(char));
+#ifdef _WIN32
+			addEntry(&ls, !stat(path, &es) && S_ISDIR(es.st_mode), de->d_name);
+#else
+			addEntry(&ls, !lstat(path, &es) && S_ISDIR(es.st_mode), de->d_name);
+#endif
+		}
+	}
+	if (dp)
+		closedir(dp);
+#endif
+	// entries are sorted, so that numbering and --resume see the same order in every run
+	char** entries = malloc(ls.count * sizeof(char*));
+	for (size_t i = 0; i < ls.count; ++i)
+		entries[i] = ls.names + ls.offs[i];
+	qsort(entries, ls.count, sizeof(char*), compareEntries);
+	free(ls.offs);
+
+	g_mutex_lock(&wlk->mutex);
+	dir->names = ls.names;
+	dir->entries = entries;
+	dir->count = ls.count;
+	dir->err = err;
+	dir->listed = true;
+	g_cond_broadcast(&wlk->cond);
+	g_mutex_unlock(&wlk->mutex);
+}
+
+Walker* newWalker(const Arguments* arg, const Filter* flt) {
+	Walker* wlk = malloc(sizeof(Walker));
+	g_mutex_init(&wlk->mutex);
+	g_cond_init(&wlk->cond);
+	wlk->pool = g_thread_pool_new((GFunc)listDirectory, wlk, (int)g_get_num_processors(), FALSE, NULL);
+	wlk->stack = g_ptr_array_new();
+	wlk->filter = flt;
+	wlk->maxDepth = arg->maxDepth;
+	wlk->rootDev = 0;
+	wlk->oneFs = arg->oneFileSystem;
+	wlk->filesOnly = arg->filesOnly;
+	wlk->dirsOnly = arg->dirsOnly;
+	return wlk;
+}
+
+static void submitDirectory(Walker* wlk, WalkDir* dir) {
+	size_t id = dir->submitted++;
+	const char* name = dir->entries[dir->subIds[id]] + 1;
+	WalkDir* sub = newWalkDir(dir->path, dir->plen, name, strlen(name), dir->depth + 1);
+	sub->slot = id;
+	dir->subs[id] = sub;
+	g_thread_pool_push(wlk->pool, sub, NULL);
+}
+
+static void enterDirectory(Walker* wlk, WalkDir* dir) {
+	dir->entered = true;
+	if (wlk->maxDepth >= 0 && dir->depth + 1 >= wlk->maxDepth)
+		return;
+
+	dir->subIds = malloc(dir->count * sizeof(size_t));
+	for (size_t i = 0; i < dir->count; ++i)
+		if (dir->entries[i][0] == ENTRY_DIR && dir->plen + strlen(dir->entries[i]) < PATH_MAX && !filterPrune(wlk->filter, dir->entries[i] + 1))
+			dir->subIds[dir->nSubs++] = i;
+	dir->subs = malloc(dir->nSubs * sizeof(WalkDir*));
+
+	// only the next few subdirectories are read ahead, which keeps the memory use independent of the tree's size
+	while (dir->submitted < MIN(dir->nSubs, WALK_PREFETCH))
+		submitDirectory(wlk, dir);
+}
+
+static const char* walkName(const char* path, size_t plen) {
+	const char* sep = memrchr(path, '/', plen * sizeof(char));
+	return sep && sep[1] ? sep + 1 : path;
+}
+
+WalkStart startWalk(Walker* wlk, const char* root, size_t rlen, Window* win) {
+	const char* name = walkName(root, rlen);
+	struct stat ps;
+#ifdef _WIN32
+	if (stat(root, &ps)) {
+#else
+	if (lstat(root, &ps)) {
+#endif
+		showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to read '%s': %s", root, strerror(errno));
+		return WALK_SKIP;
+	}
+	if (!S_ISDIR(ps.st_mode))
+		return !wlk->dirsOnly && filterName(wlk->filter, name, false) ? WALK_EMIT : WALK_SKIP;
+	if (!wlk->maxDepth)
+		return !wlk->filesOnly && filterName(wlk->filter, name, true) ? WALK_EMIT : WALK_SKIP;
+	if (filterPrune(wlk->filter, name))
+		return WALK_SKIP;
+
+	for (; rlen > 1 && root[rlen - 1] == '/'; --rlen);
+	wlk->rootDev = ps.st_dev;
+	WalkDir* dir = newWalkDir(root, rlen, NULL, 0, 0);
+	g_ptr_array_add(wlk->stack, dir);
+	g_thread_pool_push(wlk->pool, dir, NULL);
+	return WALK_STARTED;
+}
+
+bool nextWalk(Walker* wlk, char* path, size_t* plen, Window* win) {
+	while (wlk->stack->len) {
+		WalkDir* dir = g_ptr_array_index(wlk->stack, wlk->stack->len - 1);
+		if (!dir->entered) {
+			g_mutex_lock(&wlk->mutex);
+			while (!dir->listed)
+				g_cond_wait(&wlk->cond, &wlk->mutex);
+			g_mutex_unlock(&wlk->mutex);
+			if (dir->err)
+				showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Failed to read directory '%s': %s", dir->path, strerror(dir->err));
+			enterDirectory(wlk, dir);
+		}
+
+		if (dir->next < dir->count) {
+			size_t id = dir->next++;
+			const char* entry = dir->entries[id];
+			if (dir->nextSub < dir->nSubs && dir->subIds[dir->nextSub] == id) {
+				g_ptr_array_add(wlk->stack, dir->subs[dir->nextSub++]);
+				if (dir->submitted < dir->nSubs)
+					submitDirectory(wlk, dir);
+				continue;
+			}
+			if ((entry[0] == ENTRY_DIR ? wlk->filesOnly : wlk->dirsOnly) || !filterName(wlk->filter, entry + 1, entry[0] == ENTRY_DIR))
+				continue;
+
+			size_t nlen = strlen(entry + 1);
+			bool sep = dir->path[dir->plen - 1] != '/';
+			if (dir->plen + sep + nlen >= PATH_MAX) {
+				showMessage(win, MESSAGE_ERROR, BUTTONS_OK, "Path '%s/%s' is too long", dir->path, entry + 1);
+				continue;
+			}
+			memcpy(path, dir->path, dir->plen * sizeof(char));
+			path[dir->plen] = '/';
+			memcpy(path + dir->plen + sep, entry + 1, (nlen + 1) * sizeof(char));
+			*plen = dir->plen + sep + nlen;
+			return true;
+		}
+
+		// a directory is only returned after everything inside it, so renaming it doesn't invalidate the paths of its contents
+		g_ptr_array_remove_index(wlk->stack, wlk->stack->len - 1);
+		if (wlk->stack->len)
+			((WalkDir*)g_ptr_array_index(wlk->stack, wlk->stack->len - 1))->subs[dir->slot] = NULL;
+		bool emit = !wlk->filesOnly && filterName(wlk->filter, walkName(dir->path, dir->plen), true);
+		if (emit) {
+			memcpy(path, dir->path, (dir->plen + 1) * sizeof(char));
+			*plen = dir->plen;
+		}
+		freeWalkDir(dir);
+		if (emit)
+			return true;
+	}
+	return false;
+}
+
+void freeWalker(Walker* wlk) {
+	// queued listings are dropped and the running ones finished, after which the root owns every remaining directory
+	g_thread_pool_free(wlk->pool, TRUE, TRUE);
+	if (wlk->stack->len)
+		freeWalkDir(g_ptr_array_index(wlk->stack, 0));
+	g_ptr_array_free(wlk->stack, TRUE);
+	g_cond_clear(&wlk->cond);
+	g_mutex_clear(&wlk->mutex);
+	free(wlk);
+}
@@ -0,0 +1,17 @@
+#ifndef WALKER_H
+#define WALKER_H
+
+#include "utils.h"
+
+typedef enum WalkStart {
+	WALK_SKIP,
+	WALK_EMIT,
+	WALK_STARTED
+} WalkStart;
+
+Walker* newWalker(const Arguments* arg, const Filter* flt);
+WalkStart startWalk(Walker* wlk, const char* root, size_t rlen, Window* win);
+bool nextWalk(Walker* wlk, char* path, size_t* plen, Window* win);
+void freeWalker(Walker* wlk);
+
+#endif
@@ -119,6 +119,7 @@ static bool resetParameters(Window* win, Arguments* arg) {
 		bool tmp = set->autoPreview;
 		set->autoPreview = false;
 		resetNameParameters(win, arg);
+		gtk_combo_box_set_active(GTK_COMBO_BOX(win->cmbDestinationMode), arg->destinationMode);
 		freeArguments(arg);
 		set->autoPreview = tmp;
 		autoPreview(win);
@@ -161,6 +162,7 @@ static void toggleShowDetails(GtkCheckMenuItem* checkmenuitem, Window* win) {
 
 void activateClear(GtkMenuItem* item, Window* win) {
 	gtk_list_store_clear(win->lsFiles);
+	g_hash_table_remove_all(win->fileMeta);
 }
 
 static void resetAllParameters(Window* win) {
@@ -450,6 +452,8 @@ Window* openWindow(GtkApplication* app, const Arguments* arg, Process* prc, GFil
 		free(win);
 		return NULL;
 	}
+	// metadata from an input list is kept by path, since the table only holds the strings that are shown
+	win->fileMeta = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free);
 	win->window = GTK_APPLICATION_WINDOW(gtk_builder_get_object(builder, "window"));
 	win->btAddFiles = GTK_BUTTON(gtk_builder_get_object(builder, "btAddFiles"));
 	win->btAddFolders = GTK_BUTTON(gtk_builder_get_object(builder, "btAddFolders"));
@@ -522,8 +526,10 @@ Window* openWindow(GtkApplication* app, const Arguments* arg, Process* prc, GFil
 	g_object_unref(builder);
 	gtk_application_add_window(app, GTK_WINDOW(win->window));
 	gtk_widget_show_all(GTK_WIDGET(win->window));
-	if (files)
-		addFilesFromArguments(win, files, nFiles);
+	if (arg->filesFrom)
+		addFilesFromList(win, arg);
+	else if (files)
+		addFilesFromArguments(win, arg, files, nFiles);
 	return win;
 }
 
@@ -531,6 +537,9 @@ void freeWindow(Window* win) {
 	if (win) {
 		saveSettings(&win->sets);
 		freeSettings(&win->sets);
+		g_hash_table_destroy(win->fileMeta);
+		if (win->staleMeta)
+			g_ptr_array_free(win->staleMeta, TRUE);
 		free(win);
 	}
 }
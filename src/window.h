@@ -32,6 +32,8 @@ typedef struct Window {
 	GThread* thread;
 	GtkTreeIter lastFile;
 	GtkTreeIter* lastFilePtr;
+	GHashTable* fileMeta;
+	GPtrArray* staleMeta;
 
 	GtkApplicationWindow* window;
 	GtkButton* btAddFiles;